@@ -1,15 +1,19 @@
 #include <iostream>
 #include<vector>
+#include "csr_graph.h"
+#include "edge_stream.h"
+#include "bench_graphs.h"
+#include "reorder.h"
 using namespace std;
 
-bool dfs(int v, vector<vector<int>> &adj, vector<bool> &visited, int parent)
+bool dfs(int v, const CSRGraph &adj, vector<bool> &visited, int parent)
 {
     // current node is vector "visited[]", holds T or F for each vertex in adj_list{} 
     visited[v] = true;
 
     // Recur for all the vertices adjacent to this vertex
     // recursive func for adj vertices of v
-    for (int i : adj[v])
+    for (int i : adj.neighbors(v))
     {
         // check dfs() if adj vertice 'i' is not visited
         if (!visited[i])
@@ -28,9 +32,9 @@ bool dfs(int v, vector<vector<int>> &adj, vector<bool> &visited, int parent)
 }
 
 // Returns true if the graph contains a cycle, else false.
-bool isCycle(vector<vector<int>> &adj)
+bool isCycle(const CSRGraph &adj)
 {
-    int V= adj.size();
+    int V= adj.n;
     vector<bool> visited(V, false);     // mark all vertices F (not visited)
 
     for (int u = 0; u < V; u++)
@@ -45,9 +49,48 @@ bool isCycle(vector<vector<int>> &adj)
     return false;
 }
 
-int main()
+// isCycle() before / after relabelling, on an acyclic graph so the DFS has
+// to visit everything. ./1 reorder [n]
+void reorderBenchmark(int n)
 {
-    vector<vector<int>> adj = {{1, 2}, {0, 2}, {0, 1, 3}, {2}};
+    auto kernel = [](const CSRGraph &g, int) { return vector<char>(1, isCycle(g)); };
+    char name[64];
+    snprintf(name, sizeof name, "dfs, random tree n=%d", n);
+    reorderReport(name, randomTree(n), kernel);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1 && string(argv[1]) == "reorder")
+    {
+        reorderBenchmark(argc > 2 ? atoi(argv[2]) : 4000000);
+        return 0;
+    }
+
+    // ./1 stream edges.txt|- [n]  -> one pass over an edge list, O(V) memory
+    if (argc > 2 && string(argv[1]) == "stream")
+    {
+        try {
+            StreamSummary s = streamUnionFind(argv[2], argc > 3 ? atoi(argv[3]) : 0);
+            s.hasCycle ? cout << "true" : cout << "false";
+            cout << endl;
+            printStreamStats(s);
+        } catch (const exception& e) {
+            cout << e.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // ./1 graph.csr  -> run on a binary graph written by csr_convert
+    if (argc > 1)
+    {
+        CSRGraph g = loadCSR(argv[1]);
+        isCycle(g) ? cout << "true" : cout << "false";
+        return 0;
+    }
+
+    CSRGraph adj = fromAdjList({{1, 2}, {0, 2}, {0, 1, 3}, {2}});
 
     // adj list:
     //      0    1    2    3
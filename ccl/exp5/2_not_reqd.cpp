@@ -1,9 +1,14 @@
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <random>
+#include "csr_graph.h"
+#include "parallel.h"
+#include "bench_graphs.h"
 using namespace std;
 
 // helping (utility) DFS function to detect cycle in a directed graph
-bool isCyclicUtil(vector<vector<int>>& adj, int u, vector<bool>& visited, vector<bool>& recStack) {
+bool isCyclicUtil(const CSRGraph& adj, int u, vector<bool>& visited, vector<bool>& recStack) {
     
     // it is in the path of checking 'isCycle', hence cycle exists!
     if (recStack[u]) return true;
@@ -15,7 +20,7 @@ bool isCyclicUtil(vector<vector<int>>& adj, int u, vector<bool>& visited, vector
     recStack[u] = true;
 
     // recursive func adj nodes
-    for (int v : adj[u]) {
+    for (int v : adj.neighbors(u)) {
         if (isCyclicUtil(adj, v, visited, recStack))
             return true;
     }
@@ -25,8 +30,8 @@ bool isCyclicUtil(vector<vector<int>>& adj, int u, vector<bool>& visited, vector
 }
 
 // Function to detect cycle in a directed graph
-bool isCyclic(vector<vector<int>>& adj) {
-    int V = adj.size();
+bool isCyclic(const CSRGraph& adj) {
+    int V = adj.n;
     vector<bool> visited(V, false);
     vector<bool> recStack(V, false);
 
@@ -38,8 +43,407 @@ bool isCyclic(vector<vector<int>>& adj) {
     return false;
 }
 
-int main() {
-    vector<vector<int>> adj = {{1},{2},{0, 3}};
+struct SCCResult {
+    int count = 0;
+    vector<int> comp;       // comp[v] = SCC id in [0, count), numbered by smallest member
+    CSRGraph condensed;     // one vertex per SCC, deduplicated edges between SCCs (a DAG)
+};
+
+// Scratch for the iterative Tarjan below, reused across calls.
+struct TarjanScratch {
+    vector<int> index, low, stack;
+    vector<char> onStack;
+    vector<pair<int, int64_t>> calls;   // (vertex, next edge) instead of recursion
+    int counter = 0;
+    explicit TarjanScratch(int n) : index(n, -1), low(n, 0), onStack(n, 0) {}
+};
+
+// Iterative Tarjan from every vertex in `roots`, following only edges into
+// unassigned vertices of the same partition (part == nullptr: whole graph).
+// Assigns comp[] ids starting at nextComp.
+static void tarjan(const CSRGraph& g, const vector<int>& roots, const int* part, vector<int>& comp,
+                   int& nextComp, TarjanScratch& s) {
+    auto follow = [&](int from, int to) {
+        return comp[to] == -1 && (part == nullptr || part[to] == part[from]);
+    };
+    for (int root : roots) {
+        if (s.index[root] != -1 || comp[root] != -1) continue;
+        s.calls.push_back({root, g.offsets[root]});
+        s.index[root] = s.low[root] = s.counter++;
+        s.stack.push_back(root);
+        s.onStack[root] = 1;
+
+        while (!s.calls.empty()) {
+            auto& [u, e] = s.calls.back();
+            if (e < g.offsets[u + 1]) {
+                int v = g.targets[e++];
+                if (!follow(u, v)) continue;
+                if (s.index[v] == -1) {
+                    s.index[v] = s.low[v] = s.counter++;
+                    s.stack.push_back(v);
+                    s.onStack[v] = 1;
+                    s.calls.push_back({v, g.offsets[v]});    // invalidates u / e
+                } else if (s.onStack[v]) {
+                    s.low[u] = min(s.low[u], s.index[v]);
+                }
+                continue;
+            }
+            int done = u;
+            s.calls.pop_back();
+            if (!s.calls.empty()) {
+                int caller = s.calls.back().first;
+                s.low[caller] = min(s.low[caller], s.low[done]);
+            }
+            if (s.low[done] == s.index[done]) {
+                int id = nextComp++;
+                while (true) {
+                    int x = s.stack.back();
+                    s.stack.pop_back();
+                    s.onStack[x] = 0;
+                    comp[x] = id;
+                    if (x == done) break;
+                }
+            }
+        }
+    }
+}
+
+// Renumbers SCCs by smallest member (so both engines agree on ids) and
+// builds the condensation.
+static void finishSCC(const CSRGraph& g, SCCResult& res) {
+    vector<int> rename(res.count, -1);
+    int next = 0;
+    for (int v = 0; v < g.n; v++) {
+        if (rename[res.comp[v]] == -1) rename[res.comp[v]] = next++;
+        res.comp[v] = rename[res.comp[v]];
+    }
+
+    vector<pair<int, int>> arcs;
+    for (int u = 0; u < g.n; u++)
+        for (int v : g.neighbors(u))
+            if (res.comp[u] != res.comp[v]) arcs.push_back({res.comp[u], res.comp[v]});
+    sort(arcs.begin(), arcs.end());
+    arcs.erase(unique(arcs.begin(), arcs.end()), arcs.end());
+    vector<int> src, dst;
+    for (auto& a : arcs) { src.push_back(a.first); dst.push_back(a.second); }
+    res.condensed = fromArcs(res.count, src, dst);
+}
+
+// Single-threaded SCCs: iterative Tarjan, so depth is not limited by the stack.
+SCCResult sccTarjan(const CSRGraph& g) {
+    SCCResult res;
+    res.comp.assign(g.n, -1);
+    TarjanScratch s(g.n);
+    vector<int> all(g.n);
+    for (int v = 0; v < g.n; v++) all[v] = v;
+    tarjan(g, all, nullptr, res.comp, res.count, s);
+    finishSCC(g, res);
+    return res;
+}
+
+// Parallel SCCs: trimming, then forward-backward (Fleischer, Hendrickson,
+// Pinar) with the small leftover pieces handed to Tarjan.
+//  1. Trim: a vertex with no live in- or out-edges is an SCC by itself;
+//     removing it can expose more, so this cascades like Kahn's algorithm.
+//  2. FW-BW: inside a partition, the vertices both reachable from a pivot and
+//     reaching it form the pivot's SCC; every other SCC lies entirely in
+//     FW \ BW, BW \ FW or the remainder, so those become new partitions.
+//     Reachability is a parallel BFS restricted to the partition.
+SCCResult sccParallel(const CSRGraph& g) {
+    const size_t SMALL = 4096;
+    int n = g.n;
+    int T = threadPool().size();
+    CSRGraph gt = transposeOf(g);
+
+    SCCResult res;
+    res.comp.assign(n, -1);
+    int* comp = res.comp.data();
+    int nextComp = 0;
+
+    // 1. trim
+    vector<int> indeg(n), outdeg(n);
+    parallelFor(0, n, [&](int, int64_t u) {
+        int o = 0, i = 0;
+        for (int v : g.neighbors((int)u)) o += v != u;
+        for (int v : gt.neighbors((int)u)) i += v != u;
+        outdeg[u] = o;
+        indeg[u] = i;
+    });
+    vector<vector<int>> local(T);
+    auto claim = [&](int tid, int v) {
+        int unset = -1;
+        if (__atomic_compare_exchange_n(&comp[v], &unset, __atomic_fetch_add(&nextComp, 1, __ATOMIC_RELAXED),
+                                        false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            local[tid].push_back(v);
+    };
+    vector<int> frontier;
+    auto gatherLocal = [&] {
+        frontier.clear();
+        for (auto& l : local) { frontier.insert(frontier.end(), l.begin(), l.end()); l.clear(); }
+    };
+    parallelFor(0, n, [&](int tid, int64_t u) {
+        if (indeg[u] == 0 || outdeg[u] == 0) claim(tid, (int)u);
+    }, 4096);
+    gatherLocal();
+    while (!frontier.empty()) {
+        parallelFor(0, (int64_t)frontier.size(), [&](int tid, int64_t i) {
+            int u = frontier[i];
+            for (int v : g.neighbors(u))
+                if (v != u && __atomic_sub_fetch(&indeg[v], 1, __ATOMIC_RELAXED) == 0) claim(tid, v);
+            for (int v : gt.neighbors(u))
+                if (v != u && __atomic_sub_fetch(&outdeg[v], 1, __ATOMIC_RELAXED) == 0) claim(tid, v);
+        }, 256);
+        gatherLocal();
+    }
+
+    // 2. forward-backward on what is left
+    vector<int> part(n, 0), markF(n, 0), markB(n, 0);
+    int nextPart = 1, stamp = 0;
+    TarjanScratch scratch(n);
+
+    // parallel BFS from pivot over unassigned vertices of partition p
+    auto reach = [&](const CSRGraph& dir, int pivot, int p, vector<int>& mark, int st) {
+        mark[pivot] = st;
+        frontier.assign(1, pivot);
+        while (!frontier.empty()) {
+            parallelFor(0, (int64_t)frontier.size(), [&](int tid, int64_t i) {
+                for (int v : dir.neighbors(frontier[i])) {
+                    if (part[v] != p || comp[v] != -1) continue;
+                    int old = __atomic_load_n(&mark[v], __ATOMIC_RELAXED);
+                    if (old != st && __atomic_compare_exchange_n(&mark[v], &old, st, false,
+                                                                 __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                        local[tid].push_back(v);
+                }
+            }, 256);
+            gatherLocal();
+        }
+    };
+
+    vector<vector<int>> tasks(1);
+    for (int v = 0; v < n; v++)
+        if (comp[v] == -1) tasks[0].push_back(v);
+
+    while (!tasks.empty()) {
+        vector<int> verts = move(tasks.back());
+        tasks.pop_back();
+        if (verts.empty()) continue;
+        if (verts.size() < SMALL) {
+            tarjan(g, verts, part.data(), res.comp, nextComp, scratch);
+            continue;
+        }
+
+        int pivot = verts[0];
+        for (int v : verts)
+            if ((int64_t)g.degree(v) * gt.degree(v) > (int64_t)g.degree(pivot) * gt.degree(pivot)) pivot = v;
+
+        int p = part[pivot];
+        stamp++;
+        reach(g, pivot, p, markF, stamp);
+        reach(gt, pivot, p, markB, stamp);
+
+        int id = nextComp++;
+        int fwOnly = nextPart++, bwOnly = nextPart++, rest = nextPart++;
+        vector<int> fwVerts, bwVerts, restVerts;
+        for (int v : verts) {
+            bool f = markF[v] == stamp, b = markB[v] == stamp;
+            if (f && b) comp[v] = id;
+            else if (f) { part[v] = fwOnly; fwVerts.push_back(v); }
+            else if (b) { part[v] = bwOnly; bwVerts.push_back(v); }
+            else { part[v] = rest; restVerts.push_back(v); }
+        }
+        tasks.push_back(move(fwVerts));
+        tasks.push_back(move(bwVerts));
+        tasks.push_back(move(restVerts));
+    }
+
+    res.count = nextComp;
+    finishSCC(g, res);
+    return res;
+}
+
+// Tarjan on one thread, forward-backward when there are more.
+SCCResult stronglyConnectedComponents(const CSRGraph& g) {
+    return threadPool().size() == 1 ? sccTarjan(g) : sccParallel(g);
+}
+
+// Keeps a topological order of a growing DAG (Pearce & Kelly 2006), so an
+// edge that would close a cycle is rejected without a full-graph DFS.
+// Inserting u -> v with ord[u] < ord[v] is free. Otherwise only the vertices
+// whose position lies between ord[v] and ord[u] can be affected: a forward
+// search from v (cycle if it reaches u) and a backward search from u, both
+// clipped to that window, find them, and their old positions are handed back
+// out so everything reachable from v lands after everything reaching u.
+class DynamicTopoOrder {
+    vector<vector<int>> out, in;
+    vector<int> ord;                // ord[v] = position of v in the order
+    vector<unsigned> mark;          // visited stamps, cleared by bumping `epoch`
+    unsigned epoch = 0;
+    vector<int> deltaF, deltaB, stack, slots;
+
+    // Iterative DFS from `start` along `edges`, staying inside ord window
+    // (lo, hi) exclusive of the bounds already handled. Returns false if it
+    // would step onto `stop`.
+    bool collect(int start, const vector<vector<int>>& edges, int lo, int hi, int stop, vector<int>& found) {
+        found.clear();
+        stack.assign(1, start);
+        mark[start] = epoch;
+        while (!stack.empty()) {
+            int x = stack.back();
+            stack.pop_back();
+            found.push_back(x);
+            for (int y : edges[x]) {
+                if (y == stop) return false;
+                if (mark[y] != epoch && ord[y] > lo && ord[y] < hi) {
+                    mark[y] = epoch;
+                    stack.push_back(y);
+                }
+            }
+        }
+        return true;
+    }
+
+public:
+    explicit DynamicTopoOrder(int n) : out(n), in(n), ord(n), mark(n, 0) {
+        for (int v = 0; v < n; v++) ord[v] = v;
+    }
+
+    int position(int v) const { return ord[v]; }
+    const vector<int>& successors(int v) const { return out[v]; }
+
+    // Adds u -> v and returns true, or returns false (graph unchanged) if the
+    // edge would create a cycle.
+    bool addEdge(int u, int v) {
+        if (u == v) return false;
+        int lb = ord[v], ub = ord[u];
+        if (lb < ub) {
+            if (++epoch == 0) { fill(mark.begin(), mark.end(), 0); epoch = 1; }
+            if (!collect(v, out, lb, ub, u, deltaF)) return false;
+            collect(u, in, lb, ub, -1, deltaB);
+
+            auto byOrd = [&](int a, int b) { return ord[a] < ord[b]; };
+            sort(deltaF.begin(), deltaF.end(), byOrd);
+            sort(deltaB.begin(), deltaB.end(), byOrd);
+            slots.clear();
+            for (int x : deltaB) slots.push_back(ord[x]);
+            for (int x : deltaF) slots.push_back(ord[x]);
+            sort(slots.begin(), slots.end());
+            size_t i = 0;
+            for (int x : deltaB) ord[x] = slots[i++];
+            for (int x : deltaF) ord[x] = slots[i++];
+        }
+        out[u].push_back(v);
+        in[v].push_back(u);
+        return true;
+    }
+};
+
+// Streams insertions into DynamicTopoOrder and, on a short prefix, into the
+// old approach of re-running isCyclic after every edge.
+// ./2_not_reqd bench [insertions] [n]
+void benchmark(int inserts, int n) {
+    // Dependency-like stream: job ids roughly follow submission order and
+    // each job depends on jobs shortly before it. 5% of the requests point the
+    // wrong way, so they either force a reorder or close a cycle.
+    const int SPAN = 1000;
+    mt19937_64 rng(5);
+    uniform_int_distribution<int> pick(0, n - 1), gap(1, SPAN);
+    uniform_int_distribution<int> percent(0, 99);
+    vector<pair<int, int>> stream(inserts);
+    for (auto& e : stream) {
+        int b = pick(rng);
+        int a = max(0, b - gap(rng));
+        if (a == b) b = a + 1;
+        if (percent(rng) < 5) swap(a, b);
+        e = {a, b};
+    }
+
+    // baseline on a prefix: add the edge, rebuild, isCyclic, undo if cyclic
+    const int PREFIX = min(inserts, 500);
+    vector<int> src, dst;
+    vector<char> baseAccept(PREFIX);
+    Timer tb;
+    for (int i = 0; i < PREFIX; i++) {
+        src.push_back(stream[i].first);
+        dst.push_back(stream[i].second);
+        baseAccept[i] = !isCyclic(fromArcs(n, src, dst));
+        if (!baseAccept[i]) { src.pop_back(); dst.pop_back(); }
+    }
+    double baseUs = tb.ms() * 1000 / PREFIX;
+
+    DynamicTopoOrder dyn(n);
+    int accepted = 0;
+    bool agree = true;
+    Timer td;
+    for (int i = 0; i < inserts; i++) {
+        bool ok = dyn.addEdge(stream[i].first, stream[i].second);
+        accepted += ok;
+        if (i < PREFIX) agree = agree && ok == (bool)baseAccept[i];
+    }
+    double dynMs = td.ms();
+
+    bool valid = true;
+    for (int u = 0; u < n && valid; u++)
+        for (int v : dyn.successors(u))
+            valid = valid && dyn.position(u) < dyn.position(v);
+
+    printf("n=%d, %d insertions, %d accepted, %d rejected\n", n, inserts, accepted, inserts - accepted);
+    printf("isCyclic after every insert  %10.2f us/insert (first %d inserts)\n", baseUs, PREFIX);
+    printf("Pearce-Kelly                 %10.2f us/insert, %.1f ms total\n", dynMs * 1000 / inserts, dynMs);
+    printf("decisions %s, final order %s\n", agree ? "agree" : "DISAGREE", valid ? "valid" : "INVALID");
+}
+
+// SCC engines vs the yes/no isCyclic on a directed RMAT graph.
+// ./2_not_reqd bench-scc [scale]
+void benchmarkSCC(int scale) {
+    CSRGraph g = rmatGraph(scale, 8, false);
+    printf("directed rmat scale %d: n=%d m=%lld\n", scale, g.n, (long long)g.m);
+
+    Timer tc;
+    bool cyclic = isCyclic(g);
+    printf("isCyclic (yes/no only)   %9.1f ms  -> %s\n", tc.ms(), cyclic ? "cyclic" : "acyclic");
+
+    Timer tt;
+    SCCResult ref = sccTarjan(g);
+    int largest = 0;
+    {
+        vector<int> size(ref.count, 0);
+        for (int c : ref.comp) largest = max(largest, ++size[c]);
+    }
+    printf("iterative Tarjan         %9.1f ms  -> %d SCCs, largest %d, condensed DAG m=%lld\n", tt.ms(),
+           ref.count, largest, (long long)ref.condensed.m);
+
+    int maxThreads = numThreads();
+    double oneThread = 0;
+    for (int t = 1; ; t = min(t * 2, maxThreads)) {
+        setThreads(t);
+        Timer tp;
+        SCCResult r = sccParallel(g);
+        double ms = tp.ms();
+        if (t == 1) oneThread = ms;
+        printf("FW-BW + trim, %3d threads %8.1f ms  speedup x%.2f  %s\n", t, ms, oneThread / ms,
+               r.comp == ref.comp ? "identical" : "MISMATCH");
+        if (t == maxThreads) break;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "bench-scc") {
+        benchmarkSCC(argc > 2 ? atoi(argv[2]) : 20);
+        return 0;
+    }
+
+    if (argc > 1 && string(argv[1]) == "bench") {
+        benchmark(argc > 2 ? atoi(argv[2]) : 1000000, argc > 3 ? atoi(argv[3]) : 200000);
+        return 0;
+    }
+
+    if (argc > 1) {
+        CSRGraph g = loadCSR(argv[1]);
+        cout << (isCyclic(g) ? "true" : "false") << endl;
+        return 0;
+    }
+
+    CSRGraph adj = fromAdjList({{1},{2},{0, 3}, {}});
     /* adj list:
         0    1    2    3
     0   0    1    0    0
@@ -50,5 +454,15 @@ int main() {
     
     cout << (isCyclic(adj) ? "true" : "false") << endl;
 
+    SCCResult scc = stronglyConnectedComponents(adj);
+    cout << scc.count << " SCCs:";
+    for (int v = 0; v < adj.n; v++) cout << " " << v << "->" << scc.comp[v];
+    cout << endl;
+
+    // same edges, inserted one at a time: 2 -> 0 is the one that closes the cycle
+    DynamicTopoOrder dyn(4);
+    for (auto [u, v] : vector<pair<int, int>>{{0, 1}, {1, 2}, {2, 0}, {2, 3}})
+        cout << u << " -> " << v << (dyn.addEdge(u, v) ? " added" : " rejected (cycle)") << endl;
+
     return 0;
 }
\ No newline at end of file
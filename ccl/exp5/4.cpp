@@ -1,7 +1,16 @@
 #include <bits/stdc++.h>
+#include "csr_graph.h"
+#include "parallel.h"
+#include "bench_graphs.h"
+#include "reorder.h"
+#include "compressed_graph.h"
+#include "priority_queues.h"
+#include "external_graph.h"
 using namespace std;
 
-void bfs(vector<vector<int> >& graph, int S, vector<int>& par, vector<int>& dist)
+// Graph = CSRGraph or CompressedGraph
+template <class Graph>
+void bfs(const Graph& graph, int S, vector<int>& par, vector<int>& dist)
 {
     queue<int> q;
 
@@ -13,7 +22,7 @@ void bfs(vector<vector<int> >& graph, int S, vector<int>& par, vector<int>& dist
         int node = q.front();
         q.pop();
 
-        for (int neighbour : graph[node]) {
+        for (int neighbour : graph.neighbors(node)) {
             if (dist[neighbour] == 1e9) {
                 par[neighbour] = node;
                 dist[neighbour] = dist[node] + 1;
@@ -23,34 +32,540 @@ void bfs(vector<vector<int> >& graph, int S, vector<int>& par, vector<int>& dist
     }
 }
 
-void printShortestDistance(vector<vector<int>>& graph, int S, int D, int V)
+// Direction-optimizing BFS (Beamer et al.). Top-down steps expand a sparse
+// frontier queue; bottom-up steps let every unvisited vertex look for a parent
+// in a bitmap of the frontier, which is far cheaper on the few huge middle
+// levels of low-diameter graphs. The step type is picked per level from the
+// edge counts (alpha / beta heuristics from the paper).
+//
+// Fills par / dist the same way bfs() does (1e9 = unreached, -1 = no parent).
+// When several parents are equally short the one chosen may differ from bfs().
+// Bottom-up steps read neighbours as in-edges, so they need `incoming`: the
+// transpose for a directed graph, or the graph itself when it is symmetric.
+// Without it every step is top-down, which is right for any graph.
+void parallelBfs(const CSRGraph& graph, int S, vector<int>& par, vector<int>& dist,
+                 const CSRGraph* incoming = nullptr)
 {
-    vector<int> par(V, -1);
+    const int ALPHA = 14, BETA = 24;
+    const CSRGraph& in = incoming ? *incoming : graph;
+    int V = graph.n;
+    int T = threadPool().size();
+    int64_t words = (V + 63) / 64;
 
-    vector<int> dist(V, 1e9);
+    vector<int> frontier = {S};
+    vector<vector<int>> localNext(T);
+    vector<uint64_t> front(words, 0), next(words, 0);
 
-    bfs(graph, S, par, dist);
+    // per-thread counters, padded to a cache line each
+    struct alignas(64) Count { int64_t vertices = 0, edges = 0; };
+    vector<Count> counts(T);
 
-    if (dist[D] == 1e9) {
-        cout << "Source and Destination are not connected";
-        return;
+    dist[S] = 0;
+    int64_t frontierSize = 1;
+    int64_t frontierEdges = graph.degree(S);       // edges out of the frontier
+    int64_t unexploredEdges = graph.m - frontierEdges;
+    int64_t prevSize = 0;
+    bool bottomUp = false;
+
+    for (int level = 0; frontierSize > 0; level++) {
+        // only go bottom-up while the frontier is still growing; on the tail
+        // of high-diameter graphs a full vertex sweep per level never pays
+        if (!bottomUp && incoming != nullptr && frontierSize > prevSize &&
+            frontierEdges > unexploredEdges / ALPHA) {
+            fill(front.begin(), front.end(), 0);
+            for (int u : frontier) front[u >> 6] |= 1ULL << (u & 63);
+            bottomUp = true;
+        }
+
+        prevSize = frontierSize;
+        for (auto& c : counts) c = Count();
+
+        if (bottomUp) {
+            parallelFor(0, words, [&](int tid, int64_t w) {
+                uint64_t bits = 0;
+                int hi = (int)min<int64_t>(V, (w + 1) * 64);
+                for (int v = (int)(w * 64); v < hi; v++) {
+                    if (dist[v] != 1e9) continue;
+                    for (int u : in.neighbors(v)) {
+                        if (front[u >> 6] >> (u & 63) & 1) {
+                            par[v] = u;
+                            dist[v] = level + 1;
+                            bits |= 1ULL << (v & 63);
+                            counts[tid].vertices++;
+                            counts[tid].edges += graph.degree(v);
+                            break;
+                        }
+                    }
+                }
+                next[w] = bits;
+            }, 64);
+            swap(front, next);
+        } else {
+            parallelFor(0, (int64_t)frontier.size(), [&](int tid, int64_t i) {
+                int u = frontier[i];
+                for (int v : graph.neighbors(u)) {
+                    int unseen = 1e9;
+                    if (__atomic_load_n(&dist[v], __ATOMIC_RELAXED) == unseen &&
+                        __atomic_compare_exchange_n(&dist[v], &unseen, level + 1, false,
+                                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                        par[v] = u;
+                        localNext[tid].push_back(v);
+                        counts[tid].vertices++;
+                        counts[tid].edges += graph.degree(v);
+                    }
+                }
+            }, 256);
+            frontier.clear();
+            for (auto& local : localNext) {
+                frontier.insert(frontier.end(), local.begin(), local.end());
+                local.clear();
+            }
+        }
+
+        frontierSize = 0;
+        frontierEdges = 0;
+        for (auto& c : counts) {
+            frontierSize += c.vertices;
+            frontierEdges += c.edges;
+        }
+        unexploredEdges -= frontierEdges;
+
+        if (bottomUp && frontierSize < V / BETA && frontierSize < prevSize) {
+            frontier.clear();
+            for (int64_t w = 0; w < words; w++)
+                for (uint64_t bits = front[w]; bits; bits &= bits - 1)
+                    frontier.push_back((int)(w * 64 + __builtin_ctzll(bits)));
+            bottomUp = false;
+        }
+    }
+}
+
+// BFS over an ExternalGraph: par / dist in memory, the edges streamed from
+// disk once per level. Only blocks holding a vertex of the current level are
+// read, so the long tail of small levels costs little I/O; on high-diameter
+// graphs (grids, roads) most levels still touch most blocks. Same par / dist
+// convention as bfs().
+void semiExternalBfs(ExternalGraph& graph, int S, vector<int>& par, vector<int>& dist)
+{
+    vector<char> active(graph.blocks(), 0), next(graph.blocks(), 0);
+    dist[S] = 0;
+    graph.markBlocks(active, S);
+
+    for (int level = 0; ; level++) {
+        bool found = false;
+        graph.scan([&](int u, const int* targets, int count) {
+            if (dist[u] != level) return;
+            for (int i = 0; i < count; i++) {
+                int v = targets[i];
+                if (dist[v] == 1e9) {
+                    dist[v] = level + 1;
+                    par[v] = u;
+                    graph.markBlocks(next, v);
+                    found = true;
+                }
+            }
+        }, &active);
+        if (!found) break;
+        active.swap(next);
+        fill(next.begin(), next.end(), 0);
+    }
+}
+
+// Per-thread scratch for point-to-point queries. Entries are stamped with the
+// query number instead of being cleared, so a query touches only what it
+// explores and, once the buffers have grown, allocates nothing.
+struct PathWorkspace {
+    vector<int> dist[2];        // hops from S (side 0) / to D (side 1)
+    vector<int> parent[2];
+    vector<unsigned> stamp[2];
+    vector<int> frontier[2], next;
+    vector<long long> cost;     // A*: best known distance from S
+    IndexedDaryHeap<long long> heap = IndexedDaryHeap<long long>(0, 0);
+    unsigned query = 0;
+
+    void prepare(int n) {
+        if ((int)dist[0].size() == n) return;
+        for (int d = 0; d < 2; d++) {
+            dist[d].assign(n, 0);
+            parent[d].assign(n, -1);
+            stamp[d].assign(n, 0);
+        }
+        cost.assign(n, 0);
+        heap = IndexedDaryHeap<long long>(n, 0);
+        query = 0;
+    }
+
+    void begin() {
+        if (++query == 0) {
+            for (int d = 0; d < 2; d++) fill(stamp[d].begin(), stamp[d].end(), 0);
+            query = 1;
+        }
+    }
+
+    bool seen(int side, int v) const { return stamp[side][v] == query; }
+    void visit(int side, int v, int d, int p) {
+        stamp[side][v] = query;
+        dist[side][v] = d;
+        parent[side][v] = p;
+    }
+};
+
+PathWorkspace& localPathWorkspace(int n)
+{
+    thread_local PathWorkspace ws;
+    ws.prepare(n);
+    return ws;
+}
+
+// S ... meet from side 0's parents, then meet ... D from side 1's.
+static void joinPath(const PathWorkspace& ws, int meet, vector<int>& path)
+{
+    path.clear();
+    for (int v = meet; v != -1; v = ws.parent[0][v]) path.push_back(v);
+    reverse(path.begin(), path.end());
+    for (int v = ws.parent[1][meet]; v != -1; v = ws.parent[1][v]) path.push_back(v);
+}
+
+// Shortest S -> D path in an unweighted graph by BFS from both ends, always
+// expanding whole levels of the smaller frontier. Both searches only reach
+// about half the distance, which on low-diameter graphs is a tiny fraction
+// of the full BFS. The first level on which they meet holds a shortest path.
+// Fills `path` (S first, D last; empty if unreachable). The backward search
+// follows in-edges, so directed graphs pass their transpose as `incoming`.
+bool bidirectionalBfs(const CSRGraph& graph, int S, int D, vector<int>& path, PathWorkspace& ws,
+                      const CSRGraph* incoming = nullptr)
+{
+    const CSRGraph* side[2] = {&graph, incoming ? incoming : &graph};
+    ws.prepare(graph.n);
+    ws.begin();
+    ws.visit(0, S, 0, -1);
+    ws.visit(1, D, 0, -1);
+    if (S == D) {
+        path.assign(1, S);
+        return true;
+    }
+    ws.frontier[0].assign(1, S);
+    ws.frontier[1].assign(1, D);
+
+    int meet = -1, best = INT_MAX;
+    while (meet == -1 && !ws.frontier[0].empty() && !ws.frontier[1].empty()) {
+        int s = ws.frontier[0].size() <= ws.frontier[1].size() ? 0 : 1;
+        ws.next.clear();
+        for (int u : ws.frontier[s]) {
+            for (int v : side[s]->neighbors(u)) {
+                if (ws.seen(s, v)) continue;
+                ws.visit(s, v, ws.dist[s][u] + 1, u);
+                ws.next.push_back(v);
+                if (ws.seen(1 - s, v) && ws.dist[0][v] + ws.dist[1][v] < best) {
+                    best = ws.dist[0][v] + ws.dist[1][v];
+                    meet = v;
+                }
+            }
+        }
+        ws.frontier[s].swap(ws.next);
+    }
+
+    if (meet == -1) {
+        path.clear();
+        return false;
+    }
+    joinPath(ws, meet, path);
+    return true;
+}
+
+vector<int> bidirectionalBfs(const CSRGraph& graph, int S, int D, const CSRGraph* incoming = nullptr)
+{
+    vector<int> path;
+    bidirectionalBfs(graph, S, D, path, localPathWorkspace(graph.n), incoming);
+    return path;
+}
+
+// A* heuristics: h(v) must be a lower bound on the v -> target distance and
+// consistent (h(u) <= w(u, v) + h(v)), so no vertex is settled twice.
+
+// plain Dijkstra
+struct ZeroHeuristic {
+    long long operator()(int) const { return 0; }
+};
+
+// Manhattan distance for gridGraph-style ids (v = row * cols + col), each
+// step costing at least minWeight.
+struct GridHeuristic {
+    int cols, target;
+    long long minWeight = 1;
+    long long operator()(int v) const {
+        return (long long)(abs(v / cols - target / cols) + abs(v % cols - target % cols)) * minWeight;
+    }
+};
+
+// Straight-line distance for graphs with coordinates; costPerUnit is the
+// smallest weight / length ratio over all edges.
+struct CoordinateHeuristic {
+    const vector<pair<double, double>>* xy;
+    int target;
+    double costPerUnit = 1;
+    long long operator()(int v) const {
+        double dx = (*xy)[v].first - (*xy)[target].first, dy = (*xy)[v].second - (*xy)[target].second;
+        return (long long)floor(sqrt(dx * dx + dy * dy) * costPerUnit);
+    }
+};
+
+// A* from S to D; edge weights are used when the graph has them, otherwise
+// every edge costs 1. Fills `path` like bidirectionalBfs and returns the
+// path cost, or -1 if D is unreachable.
+template <class Heuristic>
+long long aStar(const CSRGraph& graph, int S, int D, Heuristic h, vector<int>& path, PathWorkspace& ws)
+{
+    ws.prepare(graph.n);
+    ws.begin();
+    ws.heap.clear();
+    ws.visit(0, S, 0, -1);
+    ws.cost[S] = 0;
+    ws.heap.push(S, h(S));
+
+    // stamp[0]: cost[] valid, stamp[1]: settled
+    while (!ws.heap.empty()) {
+        int u = ws.heap.pop().second;
+        ws.stamp[1][u] = ws.query;
+        if (u == D) break;
+        for (int64_t e = graph.offsets[u]; e < graph.offsets[u + 1]; e++) {
+            int v = graph.targets[e];
+            if (ws.seen(1, v)) continue;
+            long long nd = ws.cost[u] + (graph.weighted() ? graph.weights[e] : 1);
+            if (!ws.seen(0, v) || nd < ws.cost[v]) {
+                ws.visit(0, v, 0, u);
+                ws.cost[v] = nd;
+                ws.heap.push(v, nd + h(v));
+            }
+        }
     }
 
+    path.clear();
+    if (!ws.seen(1, D)) return -1;
+    for (int v = D; v != -1; v = ws.parent[0][v]) path.push_back(v);
+    reverse(path.begin(), path.end());
+    return ws.cost[D];
+}
+
+// `incoming` as for bidirectionalBfs: a directed graph needs its transpose.
+void printShortestDistance(const CSRGraph& graph, int S, int D, int V, const CSRGraph* incoming = nullptr)
+{
     vector<int> path;
-    int currentNode = D;
-    path.push_back(D);
-    while (par[currentNode] != -1) {
-        path.push_back(par[currentNode]);
-        currentNode = par[currentNode];
+    if (!bidirectionalBfs(graph, S, D, path, localPathWorkspace(V), incoming)) {
+        cout << "Source and Destination are not connected";
+        return;
     }
 
-    for (int i = path.size() - 1; i >= 0; i--)
-        cout << path[i] << " ";
+    for (int v : path)
+        cout << v << " ";
+}
+
+
+// Queue BFS vs direction-optimizing BFS on RMAT (low diameter) and grid
+// (high diameter) graphs. ./4 bench [rmat_scale] [grid_side]
+void benchmark(int scale, int side)
+{
+    auto run = [](const char* name, const CSRGraph& g) {
+        int S = 0;
+        for (int u = 0; u < g.n; u++)
+            if (g.degree(u) > g.degree(S)) S = u;
+
+        vector<int> par1(g.n, -1), dist1(g.n, 1e9);
+        Timer t1;
+        bfs(g, S, par1, dist1);
+        double queueMs = t1.ms();
+
+        vector<int> par2(g.n, -1), dist2(g.n, 1e9);
+        Timer t2;
+        parallelBfs(g, S, par2, dist2, &g);     // rmat and grid graphs are symmetric
+        double parMs = t2.ms();
+
+        bool ok = dist1 == dist2;
+        for (int v = 0; v < g.n && ok; v++)
+            if (v != S && dist2[v] != 1e9)
+                ok = par2[v] >= 0 && dist2[par2[v]] == dist2[v] - 1;
+
+        printf("%-22s n=%-9d m=%-10lld queue %9.1f ms   parallel %9.1f ms   x%.2f   %s\n",
+               name, g.n, (long long)g.m, queueMs, parMs, queueMs / parMs, ok ? "ok" : "MISMATCH");
+    };
+
+    printf("threads: %d\n", threadPool().size());
+    char name[64];
+    snprintf(name, sizeof name, "rmat scale %d", scale);
+    run(name, rmatGraph(scale, 16));
+    snprintf(name, sizeof name, "grid %dx%d", side, side);
+    run(name, gridGraph(side, side));
 }
 
+// Queue BFS before / after relabelling: RMAT (ids already random) and a grid
+// whose ids were shuffled. ./4 reorder [rmat_scale] [grid_side]
+void reorderBenchmark(int scale, int side)
+{
+    auto kernel = [](const CSRGraph& g, int S) {
+        vector<int> par(g.n, -1), dist(g.n, 1e9);
+        bfs(g, S, par, dist);
+        return dist;
+    };
+    char name[64];
+    snprintf(name, sizeof name, "bfs, rmat scale %d", scale);
+    reorderReport(name, rmatGraph(scale, 16), kernel);
+
+    CSRGraph grid = gridGraph(side, side);
+    snprintf(name, sizeof name, "bfs, shuffled grid %dx%d", side, side);
+    reorderReport(name, applyPermutation(grid, randomOrder(grid)), kernel);
+}
 
-int main()
+// Random point-to-point queries: full BFS from S vs bidirectional BFS, and
+// A* with the Manhattan heuristic on the grid. Path lengths are checked
+// against the full BFS. ./4 query [rmat_scale] [grid_side] [queries]
+void queryBenchmark(int scale, int side, int queries)
 {
+    auto run = [&](const char* name, const CSRGraph& g, bool grid) {
+        mt19937 rng(5);
+        uniform_int_distribution<int> pick(0, g.n - 1);
+        PathWorkspace& ws = localPathWorkspace(g.n);
+        vector<int> par(g.n), dist(g.n), path;
+        double fullMs = 0, biMs = 0, astarMs = 0;
+        bool ok = true;
+        for (int q = 0; q < queries; q++) {
+            int S = pick(rng), D = pick(rng);
+            Timer t1;
+            fill(par.begin(), par.end(), -1);
+            fill(dist.begin(), dist.end(), 1e9);
+            bfs(g, S, par, dist);
+            fullMs += t1.ms();
+            int expect = dist[D] == 1e9 ? 0 : dist[D] + 1;   // vertices on the path
+
+            Timer t2;
+            bidirectionalBfs(g, S, D, path, ws);
+            biMs += t2.ms();
+            ok = ok && (int)path.size() == expect && (expect == 0 || (path[0] == S && path.back() == D));
+
+            if (grid) {
+                Timer t3;
+                aStar(g, S, D, GridHeuristic{side, D}, path, ws);
+                astarMs += t3.ms();
+                ok = ok && (int)path.size() == expect;
+            }
+        }
+        printf("%-16s n=%-9d per query: full bfs %9.3f ms   bidirectional %9.3f ms", name, g.n,
+               fullMs / queries, biMs / queries);
+        if (grid) printf("   A* %9.3f ms", astarMs / queries);
+        printf("   %s\n", ok ? "ok" : "MISMATCH");
+    };
+
+    char name[64];
+    snprintf(name, sizeof name, "rmat scale %d", scale);
+    run(name, rmatGraph(scale, 16), false);
+    snprintf(name, sizeof name, "grid %dx%d", side, side);
+    run(name, gridGraph(side, side), true);
+}
+
+// Queue BFS on CSR vs the varint-compressed copy of the same graph, best of
+// three runs each. Compression needs id locality, so RMAT is degree-sorted
+// and the grid RCM-ordered first. ./4 compressed [rmat_scale] [grid_side]
+void compressedBenchmark(int scale, int side)
+{
+    auto run = [](const char* name, const CSRGraph& g) {
+        CompressedGraph c = compressGraph(g);
+        int S = 0;
+        for (int u = 0; u < g.n; u++)
+            if (g.degree(u) > g.degree(S)) S = u;
+
+        auto best = [&](const auto& graph, vector<int>& dist) {
+            double ms = 1e18;
+            for (int rep = 0; rep < 3; rep++) {
+                vector<int> par(g.n, -1);
+                dist.assign(g.n, 1e9);
+                Timer t;
+                bfs(graph, S, par, dist);
+                ms = min(ms, t.ms());
+            }
+            return ms;
+        };
+        vector<int> dist1, dist2;
+        double csrMs = best(g, dist1);
+        double compMs = best(c, dist2);
+
+        printf("%-16s csr %8.1f MB %8.1f ms   compressed %8.1f MB %8.1f ms   memory /%.2f  time x%.2f  %s\n",
+               name, csrBytes(g) / 1048576.0, csrMs, c.bytes() / 1048576.0, compMs,
+               (double)csrBytes(g) / c.bytes(), compMs / csrMs, dist1 == dist2 ? "ok" : "MISMATCH");
+    };
+
+    char name[64];
+    CSRGraph rmat = rmatGraph(scale, 16);
+    snprintf(name, sizeof name, "rmat scale %d", scale);
+    run(name, applyPermutation(rmat, degreeSortOrder(rmat)));
+    CSRGraph grid = gridGraph(side, side);
+    snprintf(name, sizeof name, "grid %dx%d", side, side);
+    run(name, applyPermutation(grid, rcmOrder(grid)));
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1 && string(argv[1]) == "bench") {
+        benchmark(argc > 2 ? atoi(argv[2]) : 20, argc > 3 ? atoi(argv[3]) : 1000);
+        return 0;
+    }
+
+    if (argc > 1 && string(argv[1]) == "query") {
+        queryBenchmark(argc > 2 ? atoi(argv[2]) : 20, argc > 3 ? atoi(argv[3]) : 1000,
+                       argc > 4 ? atoi(argv[4]) : 100);
+        return 0;
+    }
+
+    if (argc > 1 && string(argv[1]) == "compressed") {
+        compressedBenchmark(argc > 2 ? atoi(argv[2]) : 20, argc > 3 ? atoi(argv[3]) : 1000);
+        return 0;
+    }
+
+    if (argc > 1 && string(argv[1]) == "reorder") {
+        reorderBenchmark(argc > 2 ? atoi(argv[2]) : 20, argc > 3 ? atoi(argv[3]) : 1000);
+        return 0;
+    }
+
+    // ./4 external graph.csr S D [block_mb]  -> edges stay on disk
+    if (argc > 4 && string(argv[1]) == "external") {
+        try {
+            ExternalGraph g(argv[2], (size_t)(argc > 5 ? atoi(argv[5]) : 64) << 20);
+            int S = atoi(argv[3]), D = atoi(argv[4]);
+            requireVertex(g, S, "semiExternalBfs");
+            requireVertex(g, D, "semiExternalBfs");
+            vector<int> par(g.n, -1), dist(g.n, 1e9);
+            semiExternalBfs(g, S, par, dist);
+            if (dist[D] == 1e9)
+                cout << "Source and Destination are not connected";
+            else {
+                vector<int> path;
+                for (int v = D; v != -1; v = par[v]) path.push_back(v);
+                for (int i = path.size() - 1; i >= 0; i--)
+                    cout << path[i] << " ";
+            }
+            cout << endl;
+            printIoStats(g);
+        } catch (const exception& e) {
+            cout << e.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // ./4 graph.csr S D  -> the file may be directed, so search back along its transpose
+    if (argc > 3) {
+        try {
+            CSRGraph g = loadCSR(argv[1]);
+            int S = atoi(argv[2]), D = atoi(argv[3]);
+            requireVertex(g, S, "printShortestDistance");
+            requireVertex(g, D, "printShortestDistance");
+            CSRGraph gt = transposeOf(g);
+            printShortestDistance(g, S, D, g.n, &gt);
+        } catch (const exception& e) {
+            cout << e.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
+
     int V = 8, E = 10;
     int S = 2, D = 6;
     vector<vector<int> > edges
@@ -58,11 +573,7 @@ int main()
             { 4, 7 }, { 3, 7 }, { 6, 7 }, { 4, 5 },
             { 4, 6 }, { 5, 6 } };
 
-    vector<vector<int> > graph(V);
-    for (auto edge : edges) {
-        graph[edge[0]].push_back(edge[1]);
-        graph[edge[1]].push_back(edge[0]);
-    }
+    CSRGraph graph = fromEdgeList(V, edges);
 
     printShortestDistance(graph, S, D, V);
     return 0;
@@ -1,37 +1,76 @@
 #include <iostream>
 #include <vector>
-#include <stack>
+#include <algorithm>
+#include <random>
+#include "csr_graph.h"
+#include "parallel.h"
+#include "bench_graphs.h"
 using namespace std;
 
-void findTopoSort(int node, vector<int>& vis, vector<vector<int>>& adj, stack<int>& st) {
-    vis[node] = 1;
-    for (int it : adj[node]) {
-        if (!vis[it]) {
-            findTopoSort(it, vis, adj, st);
-        }
-    }
+struct TopoLayers {
+    bool acyclic;
+    vector<int> order;              // flat topological order, layer by layer
+    vector<int64_t> layerStart;     // layer i = order[layerStart[i] .. layerStart[i+1])
 
-    st.push(node);
-}
+    int layers() const { return (int)layerStart.size() - 1; }
+};
+
+// Level-synchronous Kahn's algorithm. Layer 0 holds the vertices with no
+// dependencies; layer i+1 the vertices whose last dependency is in layer i,
+// i.e. everything in a layer can run at once. Each layer is expanded in
+// parallel with atomic in-degree counters, and is sorted so the output does
+// not depend on thread timing. No recursion, so depth is not a problem.
+// If the graph has a cycle, the vertices on or behind it never reach in-degree
+// zero: acyclic is false and order holds only the part that could be sorted.
+TopoLayers parallelTopoSort(const CSRGraph& adj) {
+    int n = adj.n;
+    int T = threadPool().size();
+    vector<int> indeg(n, 0);
+    int* deg = indeg.data();
 
-vector<int> topoSort(vector<vector<int>>& adj) {
-    int n = adj.size();
-    stack<int> st;
-    vector<int> vis(n, 0);
+    parallelFor(0, adj.m, [&](int, int64_t e) {
+        __atomic_fetch_add(&deg[adj.targets[e]], 1, __ATOMIC_RELAXED);
+    }, 1 << 14);
 
-    for (int i = 0; i < n; i++) {
-        if (!vis[i]) {
-            findTopoSort(i, vis, adj, st);
+    vector<vector<int>> local(T);
+    auto collect = [&](TopoLayers& res) {
+        int64_t start = (int64_t)res.order.size();
+        for (auto& l : local) {
+            res.order.insert(res.order.end(), l.begin(), l.end());
+            l.clear();
         }
-    }
+        if ((int64_t)res.order.size() - start > 1) sort(res.order.begin() + start, res.order.end());
+        if ((int64_t)res.order.size() > start) res.layerStart.push_back((int64_t)res.order.size());
+    };
+
+    TopoLayers res;
+    res.order.reserve(n);
+    res.layerStart.push_back(0);
+
+    parallelFor(0, n, [&](int tid, int64_t v) {
+        if (deg[v] == 0) local[tid].push_back((int)v);
+    }, 1 << 14);
+    collect(res);
 
-    vector<int> topo;
-    
-    while (!st.empty()) {
-        topo.push_back(st.top());
-        st.pop();
+    for (int64_t begin = 0; begin < (int64_t)res.order.size(); ) {
+        int64_t end = (int64_t)res.order.size();
+        parallelFor(begin, end, [&](int tid, int64_t i) {
+            for (int v : adj.neighbors(res.order[i]))
+                if (__atomic_sub_fetch(&deg[v], 1, __ATOMIC_RELAXED) == 0)
+                    local[tid].push_back(v);
+        }, 256);
+        collect(res);
+        begin = end;
     }
-    return topo;
+
+    res.acyclic = (int)res.order.size() == n;
+    return res;
+}
+
+// Flat topological order; empty if the graph has a cycle.
+vector<int> topoSort(const CSRGraph& adj) {
+    TopoLayers res = parallelTopoSort(adj);
+    return res.acyclic ? res.order : vector<int>();
 }
 
 
@@ -39,17 +78,93 @@ void addEdge(vector<vector<int>>& adj, int u, int v) {
     adj[u].push_back(v);
 }
 
-int main() {
+// Random DAG (edges always go from a lower to a higher position of a hidden
+// permutation) plus a single long chain, the case that broke the recursive
+// version. ./5_hw bench [n]
+void benchmark(int n) {
+    mt19937_64 rng(3);
+    vector<int> perm(n);
+    for (int i = 0; i < n; i++) perm[i] = i;
+    shuffle(perm.begin(), perm.end(), rng);
+
+    vector<int> src, dst;
+    uniform_int_distribution<int> pick(0, n - 1);
+    for (int64_t e = 0; e < 4LL * n; e++) {
+        int a = pick(rng), b = pick(rng);
+        if (a == b) continue;
+        if (a > b) swap(a, b);
+        src.push_back(perm[a]); dst.push_back(perm[b]);
+    }
+    CSRGraph dag = fromArcs(n, src, dst);
+
+    src.clear(); dst.clear();
+    for (int i = 0; i + 1 < n; i++) { src.push_back(perm[i]); dst.push_back(perm[i + 1]); }
+    CSRGraph chain = fromArcs(n, src, dst);
+
+    auto valid = [](const CSRGraph& g, const TopoLayers& r) {
+        if (!r.acyclic) return false;
+        vector<int> layerOf(g.n);
+        for (int l = 0; l < r.layers(); l++)
+            for (int64_t i = r.layerStart[l]; i < r.layerStart[l + 1]; i++) layerOf[r.order[i]] = l;
+        for (int u = 0; u < g.n; u++)
+            for (int v : g.neighbors(u))
+                if (layerOf[v] <= layerOf[u]) return false;
+        return true;
+    };
+
+    int maxThreads = numThreads();
+    for (auto* c : {&dag, &chain}) {
+        const char* name = c == &dag ? "random DAG" : "chain";
+        double oneThread = 0;
+        for (int t = 1; ; t = min(t * 2, maxThreads)) {
+            setThreads(t);
+            Timer timer;
+            TopoLayers r = parallelTopoSort(*c);
+            double ms = timer.ms();
+            if (t == 1) oneThread = ms;
+            printf("%-10s n=%d m=%lld layers=%-9d threads %3d %9.1f ms  speedup x%.2f  %s\n", name, c->n,
+                   (long long)c->m, r.layers(), t, ms, oneThread / ms, valid(*c, r) ? "ok" : "INVALID");
+            if (t == maxThreads) break;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "bench") {
+        benchmark(argc > 2 ? atoi(argv[2]) : 10000000);
+        return 0;
+    }
+
+    if (argc > 1) {
+        CSRGraph g = loadCSR(argv[1]);
+        vector<int> res = topoSort(g);
+        if (res.empty() && g.n > 0)
+            cout << "graph has a cycle";
+        for (int vertex : res)
+            cout << vertex << " ";
+        cout << endl;
+        return 0;
+    }
+
     int n = 5;
     vector<vector<int>> adj(n);
-    
+
     addEdge(adj, 0, 1);
     addEdge(adj, 2, 1);
     addEdge(adj, 3, 2);
     addEdge(adj, 4, 2);
 
-    vector<int> res = topoSort(adj);
+    CSRGraph g = fromAdjList(adj);
+    vector<int> res = topoSort(g);
     for (int vertex : res)
         cout << vertex << " ";
     cout << endl;
+
+    TopoLayers layers = parallelTopoSort(g);
+    for (int l = 0; l < layers.layers(); l++) {
+        cout << "layer " << l << ":";
+        for (int64_t i = layers.layerStart[l]; i < layers.layerStart[l + 1]; i++)
+            cout << " " << layers.order[i];
+        cout << endl;
+    }
 }
@@ -2,37 +2,59 @@
 #include <vector>
 #include <queue>
 #include <climits>
+#include <limits>
+#include <stdexcept>
+#include "csr_graph.h"
+#include "priority_queues.h"
+#include "parallel.h"
+#include "bench_graphs.h"
+#include "reorder.h"
 using namespace std;
 
-vector<int> dijkstra(vector<vector<pair<int,int>>>& adj, int src) {
-
-    int V = adj.size();
+int maxEdgeWeight(const CSRGraph& adj) {
+    requireWeights(adj, "maxEdgeWeight");
+    int mx = 0;
+    for (int64_t e = 0; e < adj.m; e++)
+        mx = max(mx, adj.weights[e]);
+    return mx;
+}
 
-    priority_queue<pair<int, int>, vector<pair<int, int>>, greater<pair<int, int>>> pq;
+// Dijkstra with the priority queue as a template parameter (see
+// priority_queues.h), e.g. dijkstra<RadixHeap<long long>>(adj, src).
+// Distances use Queue::Dist, so pick a 64-bit type when path lengths can
+// exceed INT_MAX; unreached vertices stay at numeric_limits<Dist>::max().
+template <class Queue>
+vector<typename Queue::Dist> dijkstra(const CSRGraph& adj, int src) {
+    using Dist = typename Queue::Dist;
+    const Dist INF = numeric_limits<Dist>::max();
+    requireWeights(adj, "dijkstra");
+    requireVertex(adj, src, "dijkstra");
 
-    vector<int> dist(V, INT_MAX);
+    int V = adj.n;
+    Queue pq(V, (Dist)maxEdgeWeight(adj));
+    vector<Dist> dist(V, INF);
 
     dist[src] = 0;
-    pq.emplace(0, src);
+    pq.push(src, 0);
 
     while (!pq.empty()) {
-        auto top = pq.top();
-        pq.pop();
+        auto top = pq.pop();
 
-        int d = top.first;  
-        int u = top.second; 
+        Dist d = top.first;
+        int u = top.second;
 
+        // stale entry left behind by a lazy queue
         if (d > dist[u])
             continue;
 
-        for (auto &p : adj[u]) {
-            int v = p.first; 
-            int w = p.second; 
+        for (int64_t e = adj.offsets[u]; e < adj.offsets[u + 1]; e++) {
+            int v = adj.targets[e];
+            Dist nd = d + adj.weights[e];
 
             // update distance
-            if (dist[u] + w < dist[v]) {
-                dist[v] = dist[u] + w;   
-                pq.emplace(dist[v], v);
+            if (nd < dist[v]) {
+                dist[v] = nd;
+                pq.push(v, nd);
             }
         }
     }
@@ -40,8 +62,203 @@ vector<int> dijkstra(vector<vector<pair<int,int>>>& adj, int src) {
     return dist;
 }
 
+// 64-bit distances -> the int convention of dijkstra() below
+vector<int> toIntDistances(const vector<long long>& d) {
+    vector<int> dist(d.size());
+    for (size_t i = 0; i < d.size(); i++)
+        dist[i] = d[i] >= INT_MAX ? INT_MAX : (int)d[i];
+    return dist;
+}
+
+// int distances, INT_MAX for unreachable vertices. Sums are done in 64 bits,
+// so a path longer than INT_MAX is reported as INT_MAX instead of wrapping.
+vector<int> dijkstra(const CSRGraph& adj, int src) {
+    return toIntDistances(dijkstra<IndexedDaryHeap<long long>>(adj, src));
+}
+
+// atomic dist[v] = min(dist[v], nd); true if this call lowered it
+static bool relaxMin(long long* dist, int v, long long nd) {
+    long long old = __atomic_load_n(&dist[v], __ATOMIC_RELAXED);
+    while (nd < old)
+        if (__atomic_compare_exchange_n(&dist[v], &old, nd, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            return true;
+    return false;
+}
+
+// Parallel delta-stepping SSSP (Meyer & Sanders). Vertices are kept in
+// buckets of width delta. The lowest bucket is drained by repeatedly relaxing
+// its light edges (w <= delta) in parallel, since those can refill it; its
+// heavy edges only reach later buckets, so they are relaxed once afterwards.
+// Small delta approaches Dijkstra, large delta approaches Bellman-Ford.
+// Shortest distances are unique, so the output is identical to dijkstra();
+// unreached vertices are LLONG_MAX (toIntDistances() gives the int form).
+vector<long long> deltaStepping(const CSRGraph& adj, int src, long long delta) {
+    if (delta <= 0) throw invalid_argument("deltaStepping: delta must be positive");
+    requireVertex(adj, src, "deltaStepping");
+    int V = adj.n;
+    int T = threadPool().size();
+    vector<long long> dist(V, LLONG_MAX);
+    vector<long long> lightDoneAt(V, -1), heavyDoneAt(V, -1);   // dedupe repeated entries
+    long long* d = dist.data();
+
+    // Everything pushed while bucket cur is processed lands in cur ..
+    // cur + ceil(maxW / delta), so that many buckets + 1, reused circularly,
+    // hold all pending work however long the paths get.
+    long long maxW = maxEdgeWeight(adj);
+    size_t B = (size_t)(maxW / delta + (maxW % delta != 0) + 1);
+    vector<vector<vector<int>>> bins(T, vector<vector<int>>(B));    // bins[tid][bucket % B]
+    vector<vector<int>> settled(T);
+    auto push = [&](int tid, int v, long long nd) {
+        bins[tid][(size_t)(nd / delta) % B].push_back(v);
+    };
+    // moves bucket b out of every thread's bins
+    auto gather = [&](size_t b, vector<int>& out) {
+        out.clear();
+        for (auto& local : bins) {
+            out.insert(out.end(), local[b % B].begin(), local[b % B].end());
+            local[b % B].clear();
+        }
+    };
+
+    d[src] = 0;
+    size_t cur = 0;
+    vector<int> frontier = {src};
+
+    while (true) {
+        // light phase: may put vertices back into bucket cur
+        while (!frontier.empty()) {
+            parallelFor(0, (int64_t)frontier.size(), [&](int tid, int64_t i) {
+                int u = frontier[i];
+                long long du = __atomic_load_n(&d[u], __ATOMIC_RELAXED);
+                if (__atomic_exchange_n(&lightDoneAt[u], du, __ATOMIC_RELAXED) == du) return;
+                settled[tid].push_back(u);
+                for (int64_t e = adj.offsets[u]; e < adj.offsets[u + 1]; e++) {
+                    int w = adj.weights[e];
+                    if (w > delta) continue;
+                    int v = adj.targets[e];
+                    if (relaxMin(d, v, du + w)) push(tid, v, du + w);
+                }
+            }, 64);
+            gather(cur, frontier);
+        }
+
+        // heavy phase: every vertex settled in bucket cur, once
+        vector<int> done;
+        for (auto& local : settled) {
+            done.insert(done.end(), local.begin(), local.end());
+            local.clear();
+        }
+        parallelFor(0, (int64_t)done.size(), [&](int tid, int64_t i) {
+            int u = done[i];
+            long long du = d[u];
+            if (__atomic_exchange_n(&heavyDoneAt[u], du, __ATOMIC_RELAXED) == du) return;
+            for (int64_t e = adj.offsets[u]; e < adj.offsets[u + 1]; e++) {
+                int w = adj.weights[e];
+                if (w <= delta) continue;
+                int v = adj.targets[e];
+                if (relaxMin(d, v, du + w)) push(tid, v, du + w);
+            }
+        }, 64);
+
+        size_t next = SIZE_MAX;
+        for (size_t b = cur + 1; b < cur + B && next == SIZE_MAX; b++)
+            for (auto& local : bins)
+                if (!local[b % B].empty()) { next = b; break; }
+        if (next == SIZE_MAX) break;
+        cur = next;
+        gather(cur, frontier);
+    }
+    return dist;
+}
+
+// Which queue wins where: ./6 bench [grid_side] [random_n]
+void benchmark(int side, int n) {
+    struct Case { string name; CSRGraph g; };
+    vector<Case> cases;
+    cases.push_back({"road grid w<=1000", gridGraph(side, side, 1000)});
+    cases.push_back({"road grid w<=10", gridGraph(side, side, 10)});
+    cases.push_back({"random d=8 w<=1000", randomGraph(n, 4LL * n, true, 1000)});
+    cases.push_back({"random d=8 w<=10", randomGraph(n, 4LL * n, true, 10)});
+
+    printf("%-20s %12s %12s %12s %12s %12s\n", "graph (ms)", "lazy binary", "4-ary idx", "8-ary idx", "radix", "dial");
+    for (auto& c : cases) {
+        vector<long long> ref;
+        double t[5];
+        bool ok = true;
+        auto run = [&](int i, auto fn) {
+            Timer timer;
+            vector<long long> d = fn();
+            t[i] = timer.ms();
+            if (i == 0) ref = d;
+            else ok = ok && d == ref;
+        };
+        run(0, [&] { return dijkstra<BinaryHeapLazy<long long>>(c.g, 0); });
+        run(1, [&] { return dijkstra<IndexedDaryHeap<long long, 4>>(c.g, 0); });
+        run(2, [&] { return dijkstra<IndexedDaryHeap<long long, 8>>(c.g, 0); });
+        run(3, [&] { return dijkstra<RadixHeap<long long>>(c.g, 0); });
+        run(4, [&] { return dijkstra<DialQueue<long long>>(c.g, 0); });
+        printf("%-20s %12.1f %12.1f %12.1f %12.1f %12.1f  %s\n",
+               c.name.c_str(), t[0], t[1], t[2], t[3], t[4], ok ? "ok" : "MISMATCH");
+    }
+
+    // delta-stepping thread scaling, checked against the int dijkstra()
+    printf("\ndelta-stepping (delta = max weight / 2)\n");
+    int maxThreads = numThreads();
+    for (auto& c : cases) {
+        vector<int> ref = dijkstra(c.g, 0);
+        long long delta = max(1, maxEdgeWeight(c.g) / 2);
+        double oneThread = 0;
+        for (int t = 1; ; t = min(t * 2, maxThreads)) {
+            setThreads(t);
+            Timer timer;
+            vector<int> d = toIntDistances(deltaStepping(c.g, 0, delta));
+            double ms = timer.ms();
+            if (t == 1) oneThread = ms;
+            printf("%-20s threads %3d %10.1f ms  speedup x%.2f  %s\n", c.name.c_str(), t, ms,
+                   oneThread / ms, d == ref ? "identical" : "MISMATCH");
+            if (t == maxThreads) break;
+        }
+    }
+}
+
+// dijkstra() before / after relabelling. ./6 reorder [grid_side] [rmat_scale]
+void reorderBenchmark(int side, int scale) {
+    auto kernel = [](const CSRGraph& g, int src) { return dijkstra(g, src); };
+    char name[64];
+    CSRGraph grid = gridGraph(side, side, 1000);
+    snprintf(name, sizeof name, "dijkstra, shuffled grid %dx%d", side, side);
+    reorderReport(name, applyPermutation(grid, randomOrder(grid)), kernel);
+    snprintf(name, sizeof name, "dijkstra, rmat scale %d", scale);
+    reorderReport(name, rmatGraph(scale, 8, true, 1000), kernel);
+}
+
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "bench") {
+        benchmark(argc > 2 ? atoi(argv[2]) : 1000, argc > 3 ? atoi(argv[3]) : 1000000);
+        return 0;
+    }
+
+    if (argc > 1 && string(argv[1]) == "reorder") {
+        reorderBenchmark(argc > 2 ? atoi(argv[2]) : 1000, argc > 3 ? atoi(argv[3]) : 20);
+        return 0;
+    }
+
+    // ./6 weighted_graph.csr src
+    if (argc > 2) {
+        try {
+            CSRGraph g = loadCSR(argv[1]);
+            vector<long long> result = dijkstra<RadixHeap<long long>>(g, atoi(argv[2]));
+            for (long long d : result)
+                cout << (d == LLONG_MAX ? -1 : d) << " ";
+            cout << endl;
+        } catch (const exception& e) {
+            cout << e.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
 
-int main() {
     int src = 0;
 
     vector<vector<pair<int,int>>> adj(5);
@@ -51,11 +268,11 @@ int main() {
     adj[3] = {{2,2}, {4,10}};
     adj[4] = {{1,6}, {3,10}};
 
-    vector<int> result = dijkstra(adj, src);
+    vector<int> result = dijkstra(fromAdjList(adj), src);
 
     for (int d : result)
         cout << d << " ";
-    
+
     cout << " ";
 
     return 0;
@@ -0,0 +1,573 @@
+// Contraction hierarchies for repeated s -> t queries on a static weighted
+// graph (the same CSR input 6.cpp's dijkstra takes).
+//
+// Preprocessing contracts vertices one by one in order of importance, adding
+// a shortcut u -> x whenever the path u -> v -> x through the contracted v is
+// the only shortest one. A query then only ever moves "upward" in the order:
+// a forward search from s and a backward search from t, which meet at the
+// highest vertex of the shortest path after settling a few hundred vertices.
+//
+//   ./6_ch                        small example from 6.cpp
+//   ./6_ch build graph.csr g.ch   preprocess and save
+//   ./6_ch query g.ch s t         distance and path
+//   ./6_ch bench [grid_side]      preprocessing time, query latency, threads
+#include <iostream>
+#include <vector>
+#include <string>
+#include <array>
+#include <climits>
+#include <cstring>
+#include <queue>
+#include <random>
+#include <thread>
+#include <cstdio>
+#include <stdexcept>
+#include "csr_graph.h"
+#include "priority_queues.h"
+#include "parallel.h"
+#include "bench_graphs.h"
+using namespace std;
+
+class ContractionHierarchy {
+public:
+    // Upward / downward search graphs in CSR form. up[v] holds edges v -> x
+    // with rank[x] > rank[v]; down[v] holds edges x -> v with rank[x] > rank[v]
+    // (stored at v, pointing at x). mid is the contracted vertex a shortcut
+    // skips over, -1 for an original edge.
+    struct Side {
+        vector<int64_t> offsets;
+        vector<int> targets;
+        vector<long long> weights;
+        vector<int> mid;
+    };
+
+    // Per-thread query scratch. Distances are stamped with the query number
+    // instead of being cleared, so a query touches only what it explores.
+    struct Workspace {
+        vector<long long> dist[2];
+        vector<int> parent[2];
+        vector<int64_t> parentEdge[2];
+        vector<unsigned> stamp[2];
+        unsigned query = 0;
+        IndexedDaryHeap<long long> heap[2] = {IndexedDaryHeap<long long>(0, 0), IndexedDaryHeap<long long>(0, 0)};
+
+        void prepare(int n) {
+            if ((int)dist[0].size() == n) return;
+            for (int d = 0; d < 2; d++) {
+                dist[d].assign(n, LLONG_MAX);
+                parent[d].assign(n, -1);
+                parentEdge[d].assign(n, -1);
+                stamp[d].assign(n, 0);
+                heap[d] = IndexedDaryHeap<long long>(n, 0);
+            }
+            query = 0;
+        }
+    };
+
+    int n = 0;
+    vector<int> rank;
+    Side up, down;
+
+    static ContractionHierarchy build(const CSRGraph& g);
+    void save(const string& path) const;
+    static ContractionHierarchy load(const string& path);
+
+    // Shortest s -> t distance, LLONG_MAX if unreachable. Safe to call from
+    // many threads at once as long as each uses its own Workspace.
+    long long distance(int s, int t, Workspace& ws) const {
+        int meet = search(s, t, ws);
+        return meet < 0 ? LLONG_MAX : ws.dist[0][meet] + ws.dist[1][meet];
+    }
+
+    // Vertices on a shortest s -> t path (shortcuts unpacked), empty if none.
+    vector<int> path(int s, int t, Workspace& ws) const {
+        vector<int> out;
+        int meet = search(s, t, ws);
+        if (meet < 0) return out;
+
+        // forward half: s ... meet, collected backwards from meet
+        vector<pair<int, int64_t>> half;
+        for (int v = meet; v != s; v = ws.parent[0][v])
+            half.push_back({ws.parent[0][v], ws.parentEdge[0][v]});
+        out.push_back(s);
+        for (int i = (int)half.size() - 1; i >= 0; i--) {
+            int64_t e = half[i].second;
+            unpack(half[i].first, up.targets[e], up.mid[e], out);
+        }
+        // backward half: meet ... t
+        for (int v = meet; v != t; v = ws.parent[1][v]) {
+            int64_t e = ws.parentEdge[1][v];
+            unpack(v, ws.parent[1][v], down.mid[e], out);
+        }
+        return out;
+    }
+
+    // Convenience overloads with one workspace per calling thread.
+    long long distance(int s, int t) const { return distance(s, t, localWorkspace()); }
+    vector<int> path(int s, int t) const { return path(s, t, localWorkspace()); }
+
+private:
+    Workspace& localWorkspace() const {
+        thread_local Workspace ws;
+        ws.prepare(n);
+        return ws;
+    }
+
+    // Bidirectional upward Dijkstra with stall-on-demand; returns the meeting
+    // vertex of the best path, or -1.
+    int search(int s, int t, Workspace& ws) const {
+        ws.prepare(n);
+        if (++ws.query == 0) {
+            for (int d = 0; d < 2; d++) fill(ws.stamp[d].begin(), ws.stamp[d].end(), 0);
+            ws.query = 1;
+        }
+        unsigned q = ws.query;
+        const Side* sides[2] = {&up, &down};
+        const Side* stallSides[2] = {&down, &up};
+
+        auto label = [&](int d, int v, long long dv, int par, int64_t edge) {
+            if (ws.stamp[d][v] == q && ws.dist[d][v] <= dv) return;
+            ws.stamp[d][v] = q;
+            ws.dist[d][v] = dv;
+            ws.parent[d][v] = par;
+            ws.parentEdge[d][v] = edge;
+            ws.heap[d].push(v, dv);
+        };
+
+        for (int d = 0; d < 2; d++) ws.heap[d].clear();
+        label(0, s, 0, -1, -1);
+        label(1, t, 0, -1, -1);
+
+        long long best = LLONG_MAX;
+        int meet = -1;
+        while (true) {
+            bool live[2];
+            for (int d = 0; d < 2; d++)
+                live[d] = !ws.heap[d].empty() && ws.heap[d].topKey() < best;
+            if (!live[0] && !live[1]) break;
+            int d = !live[0] ? 1 : !live[1] ? 0 : (ws.heap[0].topKey() <= ws.heap[1].topKey() ? 0 : 1);
+
+            auto [du, u] = ws.heap[d].pop();
+            int o = 1 - d;
+            if (ws.stamp[o][u] == q && du + ws.dist[o][u] < best) {
+                best = du + ws.dist[o][u];
+                meet = u;
+            }
+
+            // stall: u is reached more cheaply through a higher vertex, so
+            // nothing it would relax can be on a shortest path
+            const Side& st = *stallSides[d];
+            bool stalled = false;
+            for (int64_t e = st.offsets[u]; e < st.offsets[u + 1] && !stalled; e++) {
+                int x = st.targets[e];
+                stalled = ws.stamp[d][x] == q && ws.dist[d][x] + st.weights[e] < du;
+            }
+            if (stalled) continue;
+
+            const Side& sd = *sides[d];
+            for (int64_t e = sd.offsets[u]; e < sd.offsets[u + 1]; e++)
+                label(d, sd.targets[e], du + sd.weights[e], u, e);
+        }
+        return meet;
+    }
+
+    // Appends the original vertices of edge a -> b (without a) to out.
+    void unpack(int a, int b, int mid, vector<int>& out) const {
+        vector<array<int, 3>> stack = {{a, b, mid}};
+        while (!stack.empty()) {
+            auto [x, y, m] = stack.back();
+            stack.pop_back();
+            if (m < 0) { out.push_back(y); continue; }
+            // x -> m lives in down[m] (x is higher), m -> y in up[m]
+            stack.push_back({m, y, findMid(up, m, y)});
+            stack.push_back({x, m, findMid(down, m, x)});
+        }
+    }
+
+    static int findMid(const Side& side, int v, int target) {
+        for (int64_t e = side.offsets[v]; e < side.offsets[v + 1]; e++)
+            if (side.targets[e] == target) return side.mid[e];
+        return -1;
+    }
+};
+
+namespace ch_build {
+struct Arc {
+    int to;
+    long long w;
+    int mid;
+};
+
+const int WITNESS_SETTLE_LIMIT = 50;
+
+// Contraction-time state: a mutable adjacency plus scratch for witness searches.
+struct Builder {
+    int n;
+    vector<vector<Arc>> out, in;
+    vector<char> contracted;
+    vector<int> deletedNeighbors;
+    vector<long long> dist;
+    vector<unsigned> stamp;
+    unsigned search = 0;
+    IndexedDaryHeap<long long> heap;
+
+    Builder(const CSRGraph& g)
+        : n(g.n), out(g.n), in(g.n), contracted(g.n, 0), deletedNeighbors(g.n, 0),
+          dist(g.n), stamp(g.n, 0), heap(g.n, 0) {
+        for (int u = 0; u < n; u++)
+            for (int64_t e = g.offsets[u]; e < g.offsets[u + 1]; e++)
+                if (g.targets[e] != u) addArc(u, g.targets[e], g.weights[e], -1);
+    }
+
+    // keeps a single (lightest) arc per ordered pair
+    void addArc(int u, int x, long long w, int mid) {
+        for (Arc& a : out[u])
+            if (a.to == x) {
+                if (w < a.w) {
+                    a.w = w; a.mid = mid;
+                    for (Arc& b : in[x])
+                        if (b.to == u) { b.w = w; b.mid = mid; }
+                }
+                return;
+            }
+        out[u].push_back({x, w, mid});
+        in[x].push_back({u, w, mid});
+    }
+
+    // Dijkstra from u that ignores `skip` and contracted vertices, stopping
+    // past `limit` or after WITNESS_SETTLE_LIMIT settled vertices.
+    void witnessSearch(int u, int skip, long long limit) {
+        if (++search == 0) { fill(stamp.begin(), stamp.end(), 0); search = 1; }
+        heap.clear();
+        stamp[u] = search;
+        dist[u] = 0;
+        heap.push(u, 0);
+        int settled = 0;
+        while (!heap.empty() && settled < WITNESS_SETTLE_LIMIT) {
+            auto [d, v] = heap.pop();
+            if (d > limit) break;
+            settled++;
+            for (const Arc& a : out[v]) {
+                if (a.to == skip || contracted[a.to]) continue;
+                long long nd = d + a.w;
+                if (stamp[a.to] != search || nd < dist[a.to]) {
+                    stamp[a.to] = search;
+                    dist[a.to] = nd;
+                    heap.push(a.to, nd);
+                }
+            }
+        }
+    }
+
+    long long reached(int x) const { return stamp[x] == search ? dist[x] : LLONG_MAX; }
+
+    // Shortcuts needed to contract v; added to the graph only if `apply`.
+    int contract(int v, bool apply) {
+        long long maxOut = 0;
+        for (const Arc& b : out[v])
+            if (!contracted[b.to]) maxOut = max(maxOut, b.w);
+
+        int shortcuts = 0;
+        for (const Arc& a : in[v]) {
+            int u = a.to;
+            if (contracted[u]) continue;
+            witnessSearch(u, v, a.w + maxOut);
+            for (const Arc& b : out[v]) {
+                int x = b.to;
+                if (contracted[x] || x == u) continue;
+                if (reached(x) > a.w + b.w) {
+                    shortcuts++;
+                    if (apply) addArc(u, x, a.w + b.w, v);
+                }
+            }
+        }
+        return shortcuts;
+    }
+
+    int priority(int v) {
+        int degree = 0;
+        for (const Arc& a : out[v]) degree += !contracted[a.to];
+        for (const Arc& a : in[v]) degree += !contracted[a.to];
+        return 2 * (contract(v, false) - degree) + deletedNeighbors[v];
+    }
+};
+}
+
+ContractionHierarchy ContractionHierarchy::build(const CSRGraph& g) {
+    using namespace ch_build;
+    requireWeights(g, "ContractionHierarchy::build");
+    Builder b(g);
+    int n = g.n;
+
+    // lazy-update priority queue of (priority, vertex)
+    priority_queue<pair<int, int>, vector<pair<int, int>>, greater<pair<int, int>>> order;
+    for (int v = 0; v < n; v++) order.push({b.priority(v), v});
+
+    ContractionHierarchy ch;
+    ch.n = n;
+    ch.rank.assign(n, 0);
+    vector<vector<Arc>> upArcs(n), downArcs(n);
+
+    int next = 0;
+    while (!order.empty()) {
+        int v = order.top().second;
+        order.pop();
+        if (b.contracted[v]) continue;
+        int p = b.priority(v);
+        if (!order.empty() && p > order.top().first) {
+            order.push({p, v});
+            continue;
+        }
+
+        // v's remaining arcs are exactly its edges in the hierarchy
+        for (const Arc& a : b.out[v])
+            if (!b.contracted[a.to]) upArcs[v].push_back(a);
+        for (const Arc& a : b.in[v])
+            if (!b.contracted[a.to]) downArcs[v].push_back(a);
+
+        b.contract(v, true);
+        b.contracted[v] = 1;
+        ch.rank[v] = next++;
+        for (const Arc& a : b.out[v]) b.deletedNeighbors[a.to]++;
+        for (const Arc& a : b.in[v]) b.deletedNeighbors[a.to]++;
+    }
+
+    auto flatten = [&](vector<vector<Arc>>& arcs, Side& side) {
+        side.offsets.assign(n + 1, 0);
+        for (int v = 0; v < n; v++) side.offsets[v + 1] = side.offsets[v] + (int64_t)arcs[v].size();
+        for (int v = 0; v < n; v++)
+            for (const Arc& a : arcs[v]) {
+                side.targets.push_back(a.to);
+                side.weights.push_back(a.w);
+                side.mid.push_back(a.mid);
+            }
+    };
+    flatten(upArcs, ch.up);
+    flatten(downArcs, ch.down);
+    return ch;
+}
+
+namespace ch_io {
+const char MAGIC[8] = {'C', 'H', 'G', 'R', 'A', 'P', 'H', '1'};
+
+template <class T>
+bool writeVec(FILE* f, const vector<T>& v) {
+    uint64_t size = v.size();
+    return fwrite(&size, sizeof size, 1, f) == 1 && fwrite(v.data(), sizeof(T), v.size(), f) == v.size();
+}
+
+// `left` is what remains of the file, so a corrupt size cannot make it
+// allocate more than the file holds
+template <class T>
+bool readVec(FILE* f, vector<T>& v, uint64_t& left) {
+    uint64_t size;
+    if (left < sizeof size || fread(&size, sizeof size, 1, f) != 1) return false;
+    left -= sizeof size;
+    if (size > left / sizeof(T)) return false;
+    v.resize(size);
+    left -= size * sizeof(T);
+    return fread(v.data(), sizeof(T), size, f) == size;
+}
+
+// offsets run from 0 up to the arc count, arrays agree in length, every id
+// is a vertex: what queries and path unpacking index with. Both sides store
+// at v arcs to higher-ranked vertices, and a shortcut's mid ranks below v
+// (so below both ends); unpack() only terminates because of that.
+bool validSide(const ContractionHierarchy::Side& s, const vector<int>& rank) {
+    int n = (int)rank.size();
+    size_t m = s.targets.size();
+    if (s.offsets.size() != (size_t)n + 1 || s.offsets[0] != 0 || s.offsets[n] != (int64_t)m) return false;
+    if (s.weights.size() != m || s.mid.size() != m) return false;
+    for (int v = 0; v < n; v++) {
+        if (s.offsets[v] > s.offsets[v + 1]) return false;
+        for (int64_t e = s.offsets[v]; e < s.offsets[v + 1]; e++) {
+            int x = s.targets[e], mid = s.mid[e];
+            if (x < 0 || x >= n || rank[x] <= rank[v] || s.weights[e] < 0) return false;
+            if (mid != -1 && (mid < 0 || mid >= n || rank[mid] >= rank[v])) return false;
+        }
+    }
+    return true;
+}
+
+// rank is a permutation of 0 .. n-1
+bool validRank(const vector<int>& rank) {
+    vector<char> used(rank.size(), 0);
+    for (int r : rank) {
+        if (r < 0 || (size_t)r >= rank.size() || used[r]) return false;
+        used[r] = 1;
+    }
+    return true;
+}
+}
+
+void ContractionHierarchy::save(const string& path) const {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (f == nullptr) throw runtime_error("ContractionHierarchy::save: cannot open " + path);
+    int64_t nn = n;
+    bool ok = fwrite(ch_io::MAGIC, 1, 8, f) == 8 && fwrite(&nn, sizeof nn, 1, f) == 1 &&
+              ch_io::writeVec(f, rank);
+    for (const Side* s : {&up, &down})
+        ok = ok && ch_io::writeVec(f, s->offsets) && ch_io::writeVec(f, s->targets) &&
+             ch_io::writeVec(f, s->weights) && ch_io::writeVec(f, s->mid);
+    ok = fclose(f) == 0 && ok;
+    if (!ok) throw runtime_error("ContractionHierarchy::save: write failed for " + path);
+}
+
+ContractionHierarchy ContractionHierarchy::load(const string& path) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (f == nullptr) throw runtime_error("ContractionHierarchy::load: cannot open " + path);
+    ContractionHierarchy ch;
+    char magic[8];
+    int64_t nn = 0;
+    uint64_t left = 0;
+    bool ok = fseek(f, 0, SEEK_END) == 0;
+    if (ok) {
+        long len = ftell(f);
+        ok = len >= 16 && fseek(f, 0, SEEK_SET) == 0;
+        left = ok ? (uint64_t)len - 16 : 0;
+    }
+    ok = ok && fread(magic, 1, 8, f) == 8 && memcmp(magic, ch_io::MAGIC, 8) == 0 &&
+         fread(&nn, sizeof nn, 1, f) == 1 && nn >= 0 && nn < INT_MAX && ch_io::readVec(f, ch.rank, left);
+    for (Side* s : {&ch.up, &ch.down})
+        ok = ok && ch_io::readVec(f, s->offsets, left) && ch_io::readVec(f, s->targets, left) &&
+             ch_io::readVec(f, s->weights, left) && ch_io::readVec(f, s->mid, left);
+    fclose(f);
+    ok = ok && left == 0 && ch.rank.size() == (size_t)nn && ch_io::validRank(ch.rank) &&
+         ch_io::validSide(ch.up, ch.rank) && ch_io::validSide(ch.down, ch.rank);
+    if (!ok) throw runtime_error("ContractionHierarchy::load: bad file " + path);
+    ch.n = (int)nn;
+    return ch;
+}
+
+// plain Dijkstra, as the reference answer
+long long dijkstraDistance(const CSRGraph& g, int s, int t) {
+    requireWeights(g, "dijkstraDistance");
+    vector<long long> dist(g.n, LLONG_MAX);
+    IndexedDaryHeap<long long> pq(g.n, 0);
+    dist[s] = 0;
+    pq.push(s, 0);
+    while (!pq.empty()) {
+        auto [d, u] = pq.pop();
+        if (u == t) return d;
+        for (int64_t e = g.offsets[u]; e < g.offsets[u + 1]; e++) {
+            int v = g.targets[e];
+            if (d + g.weights[e] < dist[v]) {
+                dist[v] = d + g.weights[e];
+                pq.push(v, dist[v]);
+            }
+        }
+    }
+    return LLONG_MAX;
+}
+
+// length of a vertex path in g (cheapest parallel arc), -1 if not a path
+long long pathLength(const CSRGraph& g, const vector<int>& p) {
+    requireWeights(g, "pathLength");
+    long long len = 0;
+    for (size_t i = 0; i + 1 < p.size(); i++) {
+        long long best = -1;
+        for (int64_t e = g.offsets[p[i]]; e < g.offsets[p[i] + 1]; e++)
+            if (g.targets[e] == p[i + 1] && (best < 0 || g.weights[e] < best)) best = g.weights[e];
+        if (best < 0) return -1;
+        len += best;
+    }
+    return len;
+}
+
+void benchmark(int side) {
+    CSRGraph g = gridGraph(side, side, 1000);
+    printf("road grid %dx%d: n=%d m=%lld\n", side, side, g.n, (long long)g.m);
+
+    Timer tb;
+    ContractionHierarchy ch = ContractionHierarchy::build(g);
+    printf("preprocessing     %10.1f ms, %lld up + %lld down arcs\n", tb.ms(),
+           (long long)ch.up.targets.size(), (long long)ch.down.targets.size());
+
+    string file = "/tmp/exp5_bench.ch";
+    Timer ts;
+    ch.save(file);
+    ContractionHierarchy loaded = ContractionHierarchy::load(file);
+    printf("save + load       %10.1f ms\n", ts.ms());
+    remove(file.c_str());
+
+    const int QUERIES = 20000, CHECKED = 50;
+    mt19937 rng(7);
+    uniform_int_distribution<int> pick(0, g.n - 1);
+    vector<pair<int, int>> pairs(QUERIES);
+    for (auto& p : pairs) p = {pick(rng), pick(rng)};
+
+    int bad = 0;
+    Timer td;
+    for (int i = 0; i < CHECKED; i++) {
+        auto [s, t] = pairs[i];
+        long long ref = dijkstraDistance(g, s, t);
+        vector<int> p = loaded.path(s, t);
+        if (loaded.distance(s, t) != ref || pathLength(g, p) != ref || p.front() != s || p.back() != t) bad++;
+    }
+    printf("dijkstra          %10.1f us/query (%d queries, CH answers %s)\n",
+           td.ms() * 1000 / CHECKED, CHECKED, bad ? "MISMATCH" : "identical");
+
+    int maxThreads = numThreads();
+    for (int t = 1; ; t = min(t * 2, maxThreads)) {
+        Timer tq;
+        vector<thread> workers;
+        vector<long long> sums(t, 0);
+        for (int w = 0; w < t; w++)
+            workers.emplace_back([&, w] {
+                ContractionHierarchy::Workspace ws;
+                for (int i = w; i < QUERIES; i += t)
+                    sums[w] += loaded.distance(pairs[i].first, pairs[i].second, ws);
+            });
+        for (auto& w : workers) w.join();
+        double ms = tq.ms();
+        printf("CH, %3d threads   %10.2f us/query, %.0f queries/s\n", t, ms * 1000 / QUERIES, QUERIES / ms * 1000);
+        if (t == maxThreads) break;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    string mode = argc > 1 ? argv[1] : "";
+    if (mode == "bench") {
+        benchmark(argc > 2 ? atoi(argv[2]) : 200);
+        return 0;
+    }
+    try {
+        if (mode == "build" && argc > 3) {
+            CSRGraph g = loadCSR(argv[2]);
+            ContractionHierarchy::build(g).save(argv[3]);
+            return 0;
+        }
+        if (mode == "query" && argc > 4) {
+            ContractionHierarchy ch = ContractionHierarchy::load(argv[2]);
+            int s = atoi(argv[3]), t = atoi(argv[4]);
+            if (s < 0 || s >= ch.n || t < 0 || t >= ch.n) {
+                cout << "vertices are 0 .. " << ch.n - 1 << endl;
+                return 1;
+            }
+            long long d = ch.distance(s, t);
+            if (d == LLONG_MAX) { cout << "not connected" << endl; return 0; }
+            cout << d << ":";
+            for (int v : ch.path(s, t)) cout << " " << v;
+            cout << endl;
+            return 0;
+        }
+    } catch (const exception& e) {
+        cout << e.what() << endl;
+        return 1;
+    }
+
+    vector<vector<pair<int,int>>> adj(5);
+    adj[0] = {{1,4}, {2,8}};
+    adj[1] = {{0,4}, {4,6}, {2,3}};
+    adj[2] = {{0,8}, {3,2}, {1,3}};
+    adj[3] = {{2,2}, {4,10}};
+    adj[4] = {{1,6}, {3,10}};
+
+    ContractionHierarchy ch = ContractionHierarchy::build(fromAdjList(adj));
+    for (int t = 0; t < 5; t++) {
+        cout << "0 -> " << t << " = " << ch.distance(0, t) << " :";
+        for (int v : ch.path(0, t)) cout << " " << v;
+        cout << endl;
+    }
+    return 0;
+}
@@ -1,60 +1,169 @@
 #include <bits/stdc++.h>
+#include "csr_graph.h"
+#include "parallel.h"
+#include "bench_graphs.h"
 using namespace std;
 
-// constructing adj matrix using given edge vector<vector>
-vector<vector<int>> constructadj(int V, vector<vector<int>> &edges){
-    
-    vector<vector<int>> adj(V);
-    for(auto it:edges){
-        adj[it[0]].push_back(it[1]);
-        adj[it[1]].push_back(it[0]);
-    }
-    return adj;
+// constructing CSR adjacency using given edge vector<vector>
+CSRGraph constructadj(int V, const vector<vector<int>> &edges){
+    return fromEdgeList(V, edges);
 }
 
-bool dfs(int u, int color, vector<int> &colors, vector<vector<int>> &adj) {
+struct BipartiteResult {
+    bool bipartite;
+    vector<int> colors;     // 0 / 1 side of every vertex (when bipartite)
+    vector<int> oddCycle;   // witness when not bipartite: consecutive vertices
+                            // are adjacent, and the last is adjacent to the first
+};
 
-    colors[u] = color; 
+// Parallel 2-colouring by BFS levels. Each component is explored with a
+// level-synchronous BFS whose levels are expanded in parallel (CAS on the
+// level array), and colour = level parity. In BFS every edge joins equal or
+// adjacent levels, so the graph is bipartite iff no edge joins two vertices on
+// the same level. For such an edge (u, v) the BFS tree paths from u and v up
+// to their lowest common ancestor, closed by (u, v), form an odd cycle.
+BipartiteResult parallelBipartite(const CSRGraph &adj) {
 
-    for(auto &v : adj[u]) {
-        if(colors[v] == -1) {
+    int V = adj.n;
+    int T = threadPool().size();
+    vector<int> level(V, -1), parent(V, -1);
+    vector<vector<int>> localNext(T);
+    vector<int> frontier;
 
-            if(!dfs(v, 1 - color, colors, adj))
-                return false;
+    for(int root = 0; root < V; root++) {
+        if(level[root] != -1) continue;
+        level[root] = 0;
+        frontier.assign(1, root);
+        for(int depth = 0; !frontier.empty(); depth++) {
+            parallelFor(0, (int64_t)frontier.size(), [&](int tid, int64_t i) {
+                int u = frontier[i];
+                for(int v : adj.neighbors(u)) {
+                    int unseen = -1;
+                    if(__atomic_load_n(&level[v], __ATOMIC_RELAXED) == -1 &&
+                       __atomic_compare_exchange_n(&level[v], &unseen, depth + 1, false,
+                                                   __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                        parent[v] = u;
+                        localNext[tid].push_back(v);
+                    }
+                }
+            }, 256);
+            frontier.clear();
+            for(auto &local : localNext) {
+                frontier.insert(frontier.end(), local.begin(), local.end());
+                local.clear();
+            }
         }
-        else if(colors[v] == color) {
-            return false;
+    }
+
+    // smallest vertex with a same-level neighbour, so the witness is stable
+    int bad = INT_MAX;
+    parallelFor(0, V, [&](int, int64_t u) {
+        for(int v : adj.neighbors((int)u)) {
+            if(level[v] == level[u]) {
+                int cur = __atomic_load_n(&bad, __ATOMIC_RELAXED);
+                while((int)u < cur && !__atomic_compare_exchange_n(&bad, &cur, (int)u, true,
+                                                                   __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+                return;
+            }
         }
+    }, 4096);
+
+    BipartiteResult res;
+    res.bipartite = bad == INT_MAX;
+    if(res.bipartite) {
+        res.colors.resize(V);
+        for(int u = 0; u < V; u++) res.colors[u] = level[u] & 1;
+        return res;
     }
-    return true;
+
+    int u = bad, v = -1;
+    for(int x : adj.neighbors(u))
+        if(level[x] == level[u]) { v = x; break; }
+
+    // climb both tree paths in lockstep (same depth) until they meet
+    vector<int> fromU, fromV;
+    int a = u, b = v;
+    while(a != b) {
+        fromU.push_back(a);
+        fromV.push_back(b);
+        a = parent[a];
+        b = parent[b];
+    }
+    res.oddCycle = fromU;
+    res.oddCycle.push_back(a);
+    res.oddCycle.insert(res.oddCycle.end(), fromV.rbegin(), fromV.rend());
+    return res;
 }
 
-bool isBipartite(int V, vector<vector<int>> &edges) {
+bool isBipartite(const CSRGraph &adj) {
+    return parallelBipartite(adj).bipartite;
+}
 
-    vector<int> colors(V, -1); 
-    
-    vector<vector<int>> adj = constructadj(V,edges);
+bool isBipartite(int V, vector<vector<int>> &edges) {
+    return isBipartite(constructadj(V, edges));
+}
 
-    for(int i = 0; i < V; i++) {
+// odd length, and every consecutive pair (wrapping around) is an edge
+bool validOddCycle(const CSRGraph &adj, const vector<int> &cycle) {
+    if(cycle.size() % 2 == 0) return false;
+    for(size_t i = 0; i < cycle.size(); i++) {
+        int a = cycle[i], b = cycle[(i + 1) % cycle.size()];
+        auto nb = adj.neighbors(a);
+        if(find(nb.begin(), nb.end(), b) == nb.end()) return false;
+    }
+    return true;
+}
 
-        if(colors[i] == -1) {
-            if(!dfs(i, 0, colors, adj))
-                return false; 
+// Thread scaling on a bipartite grid and a non-bipartite RMAT graph.
+// ./7_hw bench [rmat_scale] [grid_side]
+void benchmark(int scale, int side) {
+    CSRGraph grid = gridGraph(side, side);
+    CSRGraph rmat = rmatGraph(scale, 16);
+    int maxThreads = numThreads();
+    for(auto *g : {&grid, &rmat}) {
+        const char *name = g == &grid ? "grid" : "rmat";
+        double oneThread = 0;
+        for(int t = 1; ; t = min(t * 2, maxThreads)) {
+            setThreads(t);
+            Timer timer;
+            BipartiteResult r = parallelBipartite(*g);
+            double ms = timer.ms();
+            if(t == 1) oneThread = ms;
+            bool ok = r.bipartite || validOddCycle(*g, r.oddCycle);
+            if(r.bipartite)
+                for(int u = 0; u < g->n && ok; u++)
+                    for(int v : g->neighbors(u)) ok = ok && r.colors[u] != r.colors[v];
+            printf("%-5s n=%-9d m=%-10lld threads %3d %9.1f ms  speedup x%.2f  %s, %s\n", name, g->n,
+                   (long long)g->m, t, ms, oneThread / ms, r.bipartite ? "bipartite" : "odd cycle",
+                   ok ? "verified" : "INVALID");
+            if(t == maxThreads) break;
         }
     }
-
-    return true;
 }
 
 
-int main() {
-    
+int main(int argc, char* argv[]) {
+
+    if(argc > 1 && string(argv[1]) == "bench") {
+        benchmark(argc > 2 ? atoi(argv[2]) : 20, argc > 3 ? atoi(argv[3]) : 2000);
+        return 0;
+    }
+
+    if(argc > 1) {
+        CSRGraph g = loadCSR(argv[1]);
+        cout << (isBipartite(g) ? "true" : "false");
+        return 0;
+    }
+
     int V = 4;
     vector<vector<int>> edges = {{0, 1}, {0, 2}, {1, 2}, {2, 3}};
-    if(isBipartite(V, edges))
+    BipartiteResult r = parallelBipartite(constructadj(V, edges));
+    if(r.bipartite)
         cout << "true";
-    else
-        cout << "false";
-    
+    else {
+        cout << "false, odd cycle:";
+        for(int u : r.oddCycle) cout << " " << u;
+    }
+
     return 0;
 }
@@ -0,0 +1,117 @@
+// Synthetic graphs and a wall-clock timer for the `bench` modes of the exp5
+// programs. Everything is seeded, so runs are repeatable.
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "csr_graph.h"
+
+struct Timer {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double ms() const {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+// Recursive-matrix (Graph500 style) power-law graph: 2^scale vertices,
+// edgeFactor * 2^scale edges, self loops dropped. Weights in [1, maxWeight]
+// when maxWeight > 0.
+inline CSRGraph rmatGraph(int scale, int edgeFactor, bool undirected = true, int maxWeight = 0,
+                          uint64_t seed = 1) {
+    const double A = 0.57, B = 0.19, C = 0.19;
+    int n = 1 << scale;
+    int64_t edges = (int64_t)edgeFactor * n;
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+    std::uniform_int_distribution<int> weight(1, maxWeight > 0 ? maxWeight : 1);
+
+    // Random relabel so hubs are not all clustered at low ids.
+    std::vector<int> perm(n);
+    for (int i = 0; i < n; i++) perm[i] = i;
+    std::shuffle(perm.begin(), perm.end(), rng);
+
+    std::vector<int> src, dst, w;
+    src.reserve(edges * (undirected ? 2 : 1));
+    dst.reserve(src.capacity());
+    for (int64_t e = 0; e < edges; e++) {
+        int u = 0, v = 0;
+        for (int bit = 0; bit < scale; bit++) {
+            double r = coin(rng);
+            int du = (r >= A + B) ? 1 : 0;
+            int dv = (r >= A && r < A + B) || (r >= A + B + C) ? 1 : 0;
+            u |= du << bit;
+            v |= dv << bit;
+        }
+        if (u == v) continue;
+        u = perm[u]; v = perm[v];
+        int wt = weight(rng);
+        src.push_back(u); dst.push_back(v);
+        if (maxWeight > 0) w.push_back(wt);
+        if (undirected) {
+            src.push_back(v); dst.push_back(u);
+            if (maxWeight > 0) w.push_back(wt);
+        }
+    }
+    return fromArcs(n, src, dst, w);
+}
+
+// rows x cols 4-neighbour grid (a stand-in for road networks: high diameter,
+// degree <= 4). Vertex id = r * cols + c.
+inline CSRGraph gridGraph(int rows, int cols, int maxWeight = 0, uint64_t seed = 1) {
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<int> weight(1, maxWeight > 0 ? maxWeight : 1);
+    std::vector<int> src, dst, w;
+    auto add = [&](int u, int v) {
+        int wt = weight(rng);
+        src.push_back(u); dst.push_back(v);
+        src.push_back(v); dst.push_back(u);
+        if (maxWeight > 0) { w.push_back(wt); w.push_back(wt); }
+    };
+    for (int r = 0; r < rows; r++)
+        for (int c = 0; c < cols; c++) {
+            int u = r * cols + c;
+            if (c + 1 < cols) add(u, u + 1);
+            if (r + 1 < rows) add(u, u + cols);
+        }
+    return fromArcs(rows * cols, src, dst, w);
+}
+
+// Uniform random graph with n vertices and m edges (Erdos-Renyi G(n, m)).
+inline CSRGraph randomGraph(int n, int64_t m, bool undirected = true, int maxWeight = 0, uint64_t seed = 1) {
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<int> vertex(0, n - 1);
+    std::uniform_int_distribution<int> weight(1, maxWeight > 0 ? maxWeight : 1);
+    std::vector<int> src, dst, w;
+    for (int64_t e = 0; e < m; e++) {
+        int u = vertex(rng), v = vertex(rng);
+        if (u == v) continue;
+        int wt = weight(rng);
+        src.push_back(u); dst.push_back(v);
+        if (maxWeight > 0) w.push_back(wt);
+        if (undirected) {
+            src.push_back(v); dst.push_back(u);
+            if (maxWeight > 0) w.push_back(wt);
+        }
+    }
+    return fromArcs(n, src, dst, w);
+}
+
+// Random recursive tree (vertex i hangs off a uniform earlier vertex), ids
+// shuffled. Acyclic, so a cycle check has to visit every vertex; height is
+// O(log n), so recursive DFS is safe on it.
+inline CSRGraph randomTree(int n, uint64_t seed = 1) {
+    std::mt19937_64 rng(seed);
+    std::vector<int> perm(n);
+    for (int i = 0; i < n; i++) perm[i] = i;
+    std::shuffle(perm.begin(), perm.end(), rng);
+    std::vector<int> src, dst;
+    for (int i = 1; i < n; i++) {
+        int parent = std::uniform_int_distribution<int>(0, i - 1)(rng);
+        src.push_back(perm[i]); dst.push_back(perm[parent]);
+        src.push_back(perm[parent]); dst.push_back(perm[i]);
+    }
+    return fromArcs(n, src, dst);
+}
@@ -0,0 +1,172 @@
+// Compressed adjacency for graphs too big for a plain CSR. Each neighbour
+// list is sorted and stored as LEB128 varints: the degree, then the first
+// neighbour as a zig-zag difference from the vertex itself, then the gaps
+// between consecutive neighbours. Gaps are small when ids have locality, so
+// relabel first (rcmOrder / degreeSortOrder in reorder.h) for the best ratio.
+//
+// Byte positions are two-level: an int64 base per block of 64 vertices plus
+// a uint16 offset inside the block, ~2 bytes per vertex instead of 8. Blocks
+// holding 64 KB or more (hubs) keep uint32 offsets in a side array instead.
+// Unweighted only. The interface mirrors CSRGraph (n, m, degree(u),
+// neighbors(u) usable in range-for), so graph kernels can be templates over
+// either; neighbors come out in increasing id order.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include "csr_graph.h"
+
+namespace cgraph_detail {
+inline void writeVarint(std::vector<uint8_t>& out, uint32_t v) {
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+// one-byte values (the common case) take the first branch only
+inline uint32_t readVarint(const uint8_t*& p) {
+    uint32_t b = *p++;
+    if (b < 0x80) return b;
+    uint32_t v = b & 0x7f;
+    int shift = 7;
+    do {
+        b = *p++;
+        v |= (b & 0x7f) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    return v;
+}
+
+// shifts done on the unsigned value: left-shifting a negative int64 is UB
+inline uint32_t zigzag(int64_t d) { return (uint32_t)(((uint64_t)d << 1) ^ -(uint64_t)(d < 0)); }
+inline int64_t unzigzag(uint32_t z) { return (int64_t)(z >> 1) ^ -(int64_t)(z & 1); }
+}
+
+class CompressedGraph {
+    static const int BLOCK_SHIFT = 6, BLOCK = 1 << BLOCK_SHIFT;
+
+    std::vector<int64_t> blockBase;   // byte position of the first vertex of each block
+    std::vector<int> wideStart;       // per block: -1, or where its offsets start in wide
+    std::vector<uint16_t> narrow;     // byte position of u minus its block base
+    std::vector<uint32_t> wide;
+    std::vector<uint8_t> data;
+    std::vector<int64_t> pending;     // positions of the block being filled
+
+    const uint8_t* list(int u) const {
+        int b = u >> BLOCK_SHIFT;
+        int64_t rel = wideStart[b] < 0 ? narrow[u] : wide[wideStart[b] + (u & (BLOCK - 1))];
+        return data.data() + blockBase[b] + rel;
+    }
+
+    // picks the offset width once all positions of a block are known
+    void closeBlock() {
+        if (pending.empty()) return;
+        int64_t base = pending[0], span = pending.back() - base;
+        blockBase.push_back(base);
+        if (span > UINT32_MAX) throw std::runtime_error("CompressedGraph: block over 4 GB");
+        if (span <= UINT16_MAX) {
+            wideStart.push_back(-1);
+            for (int64_t pos : pending) narrow.push_back((uint16_t)(pos - base));
+        } else {
+            wideStart.push_back((int)wide.size());
+            for (int64_t pos : pending) {
+                narrow.push_back(0);
+                wide.push_back((uint32_t)(pos - base));
+            }
+        }
+        pending.clear();
+    }
+
+public:
+    int n = 0;
+    int64_t m = 0;
+
+    // Decodes on the fly; compares equal to end() once the list is used up.
+    struct Iterator {
+        const uint8_t* p;
+        int left;
+        uint32_t v;
+        int operator*() const { return (int)v; }
+        Iterator& operator++() {
+            // past the last neighbour this decodes the start of the next list
+            // (or the padding) into v, which is never read; that saves a
+            // branch per edge. v is unsigned so the sum wraps instead of
+            // overflowing.
+            left--;
+            v += cgraph_detail::readVarint(p);
+            return *this;
+        }
+        bool operator!=(const Iterator& o) const { return left != o.left; }
+    };
+
+    struct Range {
+        Iterator b;
+        Iterator begin() const { return b; }
+        Iterator end() const { return {nullptr, 0, 0}; }
+        int64_t size() const { return b.left; }
+    };
+
+    int degree(int u) const {
+        const uint8_t* p = list(u);
+        return (int)cgraph_detail::readVarint(p);
+    }
+
+    Range neighbors(int u) const {
+        const uint8_t* p = list(u);
+        int deg = (int)cgraph_detail::readVarint(p);
+        if (deg == 0) return {{p, 0, 0}};
+        uint32_t first = (uint32_t)(u + cgraph_detail::unzigzag(cgraph_detail::readVarint(p)));
+        return {{p, deg, first}};
+    }
+
+    // Appends the next vertex's neighbour list (vertices in id order);
+    // `neighbors` is sorted in place. Call finish() after the last one.
+    void addVertex(std::vector<int>& neighbors) {
+        int u = n++;
+        pending.push_back((int64_t)data.size());
+
+        std::sort(neighbors.begin(), neighbors.end());
+        cgraph_detail::writeVarint(data, (uint32_t)neighbors.size());
+        for (size_t i = 0; i < neighbors.size(); i++) {
+            if (i == 0) cgraph_detail::writeVarint(data, cgraph_detail::zigzag((int64_t)neighbors[0] - u));
+            else cgraph_detail::writeVarint(data, (uint32_t)(neighbors[i] - neighbors[i - 1]));
+        }
+        m += (int64_t)neighbors.size();
+        if (n % BLOCK == 0) closeBlock();
+    }
+
+    void finish() {
+        closeBlock();
+        data.resize(data.size() + 5, 0);   // see Iterator::operator++
+        data.shrink_to_fit();
+        narrow.shrink_to_fit();
+        wide.shrink_to_fit();
+        blockBase.shrink_to_fit();
+        wideStart.shrink_to_fit();
+    }
+
+    size_t bytes() const {
+        return data.size() + narrow.size() * sizeof(uint16_t) + wide.size() * sizeof(uint32_t) +
+               blockBase.size() * sizeof(int64_t) + wideStart.size() * sizeof(int);
+    }
+};
+
+inline CompressedGraph compressGraph(const CSRGraph& g) {
+    CompressedGraph c;
+    std::vector<int> list;
+    for (int u = 0; u < g.n; u++) {
+        list.assign(g.neighbors(u).begin(), g.neighbors(u).end());
+        c.addVertex(list);
+    }
+    c.finish();
+    return c;
+}
+
+// bytes held by an in-memory CSR graph (offsets + targets + weights)
+inline size_t csrBytes(const CSRGraph& g) {
+    return (size_t)(g.n + 1) * sizeof(int64_t) + (size_t)g.m * sizeof(int) * (g.weighted() ? 2 : 1);
+}
@@ -0,0 +1,69 @@
+// Converts a text edge list into the binary CSR format from csr_graph.h.
+//
+//   ./csr_convert edges.txt graph.csr [-u]
+//
+// Each line is "u v" or "u v w" (lines starting with '#' or '%' are skipped).
+// All lines must have the same number of fields. Vertex ids are 0-based
+// and below INT_MAX; n = largest id + 1. With -u every edge is stored in
+// both directions, same as the undirected edge lists in 3.cpp / 4.cpp.
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#include "csr_graph.h"
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        cout << "usage: " << argv[0] << " edges.txt graph.csr [-u]" << endl;
+        return 1;
+    }
+    bool undirected = argc > 3 && strcmp(argv[3], "-u") == 0;
+
+    FILE* in = fopen(argv[1], "r");
+    if (in == nullptr) {
+        cout << "cannot open " << argv[1] << endl;
+        return 1;
+    }
+
+    vector<int> src, dst, w;
+    int maxId = -1;
+    bool weighted = false, first = true;
+    char line[256];
+    long long lineNo = 0;
+    auto reject = [&](const char* why) {
+        cout << argv[1] << ":" << lineNo << ": " << why << endl;
+        fclose(in);
+        exit(1);
+    };
+    while (fgets(line, sizeof line, in)) {
+        lineNo++;
+        if (line[0] == '#' || line[0] == '%') continue;
+        long long u, v, wt;
+        int got = sscanf(line, "%lld %lld %lld", &u, &v, &wt);
+        if (got < 2) continue;
+        // every line must have as many fields as the first one
+        if (first) { weighted = (got == 3); first = false; }
+        else if (weighted != (got == 3)) reject(weighted ? "missing weight" : "unexpected weight");
+        // ids index arrays of n = max id + 1 entries, which must fit in int
+        if (u < 0 || v < 0 || u >= INT_MAX || v >= INT_MAX) reject("vertex id out of range");
+        if (weighted && (wt < INT_MIN || wt > INT_MAX)) reject("weight out of range");
+
+        src.push_back((int)u); dst.push_back((int)v);
+        if (weighted) w.push_back((int)wt);
+        if (undirected) {
+            src.push_back((int)v); dst.push_back((int)u);
+            if (weighted) w.push_back((int)wt);
+        }
+        maxId = max(maxId, (int)max(u, v));
+    }
+    fclose(in);
+
+    CSRGraph g = fromArcs(maxId + 1, src, dst, w);
+    saveCSR(g, argv[2]);
+    cout << "n = " << g.n << ", m = " << g.m << (g.weighted() ? ", weighted" : "") << endl;
+    return 0;
+}
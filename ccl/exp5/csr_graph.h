@@ -0,0 +1,283 @@
+// Compressed-sparse-row graph shared by all the exp5 graph programs.
+//
+// Neighbours of u are targets[offsets[u] .. offsets[u+1]), with the matching
+// edge weights at the same positions in weights[] (nullptr if unweighted).
+// A graph is either built in memory from the usual adjacency / edge lists,
+// or saved to a flat binary file and mmap'd back read-only, so big graphs
+// load without being rebuilt.
+//
+// Binary layout (little endian, every section 8-byte aligned):
+//   header   : magic "CSRGRAPH", uint64 n, uint64 m, uint64 flags (bit0 = weighted)
+//   offsets  : int64[n + 1]
+//   targets  : int32[m]        (padded to 8 bytes)
+//   weights  : int32[m]        (only if weighted)
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct CSRGraph {
+    int n = 0;                        // vertices
+    int64_t m = 0;                    // directed arcs (undirected edges count twice)
+    const int64_t* offsets = nullptr; // n + 1 entries
+    const int* targets = nullptr;     // m entries
+    const int* weights = nullptr;     // m entries, or nullptr
+
+    // Lightweight view over one neighbour list, usable in range-for.
+    struct Range {
+        const int* b;
+        const int* e;
+        const int* begin() const { return b; }
+        const int* end() const { return e; }
+        int64_t size() const { return e - b; }
+    };
+
+    int degree(int u) const { return (int)(offsets[u + 1] - offsets[u]); }
+    Range neighbors(int u) const { return {targets + offsets[u], targets + offsets[u + 1]}; }
+    bool weighted() const { return weights != nullptr; }
+
+    CSRGraph() = default;
+    CSRGraph(const CSRGraph&) = delete;
+    CSRGraph& operator=(const CSRGraph&) = delete;
+    CSRGraph(CSRGraph&& o) noexcept { *this = std::move(o); }
+    CSRGraph& operator=(CSRGraph&& o) noexcept {
+        if (this == &o) return *this;
+        release();
+        n = o.n; m = o.m;
+        offsets = o.offsets; targets = o.targets; weights = o.weights;
+        offsetBuf = std::move(o.offsetBuf);
+        targetBuf = std::move(o.targetBuf);
+        weightBuf = std::move(o.weightBuf);
+        mapAddr = o.mapAddr; mapLen = o.mapLen;
+        o.mapAddr = nullptr; o.mapLen = 0;
+        o.n = 0; o.m = 0;
+        o.offsets = nullptr; o.targets = nullptr; o.weights = nullptr;
+        return *this;
+    }
+    ~CSRGraph() { release(); }
+
+    // Owned storage for graphs built in memory (empty when mmap'd).
+    std::vector<int64_t> offsetBuf;
+    std::vector<int> targetBuf;
+    std::vector<int> weightBuf;
+
+    // Points the public arrays at the owned buffers.
+    void adoptBuffers() {
+        offsets = offsetBuf.data();
+        targets = targetBuf.data();
+        weights = weightBuf.empty() ? nullptr : weightBuf.data();
+    }
+
+private:
+    void* mapAddr = nullptr;
+    size_t mapLen = 0;
+
+    void release() {
+        if (mapAddr != nullptr) munmap(mapAddr, mapLen);
+        mapAddr = nullptr;
+        mapLen = 0;
+    }
+
+    friend CSRGraph loadCSR(const std::string& path);
+};
+
+// Argument checks for the algorithms that read weights[] or index by a
+// vertex id taken from the command line. A graph without edges has no
+// weight array even when it was saved as weighted, so that case passes.
+inline void requireWeights(const CSRGraph& g, const char* who) {
+    if (!g.weighted() && g.m > 0)
+        throw std::invalid_argument(std::string(who) + ": the graph has no edge weights");
+}
+
+// any graph with an `n` (CSRGraph, CompressedGraph, ExternalGraph)
+template <class Graph>
+inline void requireVertex(const Graph& g, int v, const char* who) {
+    if (v < 0 || v >= g.n)
+        throw std::invalid_argument(std::string(who) + ": " + std::to_string(v) + " is not a vertex of the graph");
+}
+
+// Builds a CSR graph from parallel arc arrays (src[i] -> dst[i], weight w[i]).
+// Counting sort by source, stable, so each neighbour list keeps input order.
+inline CSRGraph fromArcs(int n, const std::vector<int>& src, const std::vector<int>& dst,
+                         const std::vector<int>& w = {}) {
+    CSRGraph g;
+    g.n = n;
+    g.m = (int64_t)src.size();
+    g.offsetBuf.assign(n + 1, 0);
+    for (int u : src) g.offsetBuf[u + 1]++;
+    for (int u = 0; u < n; u++) g.offsetBuf[u + 1] += g.offsetBuf[u];
+
+    std::vector<int64_t> pos(g.offsetBuf.begin(), g.offsetBuf.end() - 1);
+    g.targetBuf.resize(g.m);
+    if (!w.empty()) g.weightBuf.resize(g.m);
+    for (int64_t i = 0; i < g.m; i++) {
+        int64_t at = pos[src[i]]++;
+        g.targetBuf[at] = dst[i];
+        if (!w.empty()) g.weightBuf[at] = w[i];
+    }
+    g.adoptBuffers();
+    return g;
+}
+
+// adj[u] = list of neighbours of u
+inline CSRGraph fromAdjList(const std::vector<std::vector<int>>& adj) {
+    CSRGraph g;
+    g.n = (int)adj.size();
+    g.offsetBuf.assign(g.n + 1, 0);
+    for (int u = 0; u < g.n; u++) g.offsetBuf[u + 1] = g.offsetBuf[u] + (int64_t)adj[u].size();
+    g.m = g.offsetBuf[g.n];
+    g.targetBuf.reserve(g.m);
+    for (const auto& list : adj) g.targetBuf.insert(g.targetBuf.end(), list.begin(), list.end());
+    g.adoptBuffers();
+    return g;
+}
+
+// adj[u] = list of {neighbour, weight}
+inline CSRGraph fromAdjList(const std::vector<std::vector<std::pair<int, int>>>& adj) {
+    CSRGraph g;
+    g.n = (int)adj.size();
+    g.offsetBuf.assign(g.n + 1, 0);
+    for (int u = 0; u < g.n; u++) g.offsetBuf[u + 1] = g.offsetBuf[u] + (int64_t)adj[u].size();
+    g.m = g.offsetBuf[g.n];
+    g.targetBuf.reserve(g.m);
+    g.weightBuf.reserve(g.m);
+    for (const auto& list : adj)
+        for (const auto& p : list) {
+            g.targetBuf.push_back(p.first);
+            g.weightBuf.push_back(p.second);
+        }
+    g.adoptBuffers();
+    return g;
+}
+
+// edges = {{u, v}, ...}; undirected edges are stored in both directions,
+// in the same order the old push_back loops produced.
+inline CSRGraph fromEdgeList(int n, const std::vector<std::vector<int>>& edges, bool undirected = true) {
+    std::vector<int> src, dst;
+    src.reserve(edges.size() * (undirected ? 2 : 1));
+    dst.reserve(src.capacity());
+    for (const auto& e : edges) {
+        src.push_back(e[0]); dst.push_back(e[1]);
+        if (undirected) { src.push_back(e[1]); dst.push_back(e[0]); }
+    }
+    return fromArcs(n, src, dst);
+}
+
+// reverse every arc (weights go with their arcs)
+inline CSRGraph transposeOf(const CSRGraph& g) {
+    std::vector<int> src(g.m), dst(g.m), w;
+    if (g.weighted()) w.assign(g.weights, g.weights + g.m);
+    for (int u = 0; u < g.n; u++)
+        for (int64_t e = g.offsets[u]; e < g.offsets[u + 1]; e++) {
+            src[e] = g.targets[e];
+            dst[e] = u;
+        }
+    return fromArcs(g.n, src, dst, w);
+}
+
+// every arc in both directions, so a directed graph can be read as its
+// undirected version (arcs already present both ways end up doubled)
+inline CSRGraph undirectedOf(const CSRGraph& g) {
+    std::vector<int> src, dst, w;
+    src.reserve(2 * g.m);
+    dst.reserve(2 * g.m);
+    for (int u = 0; u < g.n; u++)
+        for (int64_t e = g.offsets[u]; e < g.offsets[u + 1]; e++) {
+            src.push_back(u); dst.push_back(g.targets[e]);
+            src.push_back(g.targets[e]); dst.push_back(u);
+            if (g.weighted()) { w.push_back(g.weights[e]); w.push_back(g.weights[e]); }
+        }
+    return fromArcs(g.n, src, dst, w);
+}
+
+namespace csr_detail {
+const char MAGIC[8] = {'C', 'S', 'R', 'G', 'R', 'A', 'P', 'H'};
+
+struct Header {
+    char magic[8];
+    uint64_t n;
+    uint64_t m;
+    uint64_t flags;
+};
+
+inline size_t pad8(size_t bytes) { return (bytes + 7) & ~size_t(7); }
+}
+
+inline void saveCSR(const CSRGraph& g, const std::string& path) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (f == nullptr) throw std::runtime_error("saveCSR: cannot open " + path);
+
+    csr_detail::Header h;
+    memcpy(h.magic, csr_detail::MAGIC, 8);
+    h.n = (uint64_t)g.n;
+    h.m = (uint64_t)g.m;
+    h.flags = g.weighted() ? 1 : 0;
+
+    const char zeros[8] = {0};
+    size_t targetBytes = (size_t)g.m * sizeof(int);
+    bool ok = fwrite(&h, sizeof h, 1, f) == 1;
+    ok = ok && fwrite(g.offsets, sizeof(int64_t), g.n + 1, f) == (size_t)g.n + 1;
+    ok = ok && fwrite(g.targets, 1, targetBytes, f) == targetBytes;
+    ok = ok && fwrite(zeros, 1, csr_detail::pad8(targetBytes) - targetBytes, f) == csr_detail::pad8(targetBytes) - targetBytes;
+    if (g.weighted())
+        ok = ok && fwrite(g.weights, 1, targetBytes, f) == targetBytes;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) throw std::runtime_error("saveCSR: write failed for " + path);
+}
+
+// Maps a file written by saveCSR read-only; the arrays point straight into
+// the mapping, so nothing is copied and pages are faulted in on first use.
+inline CSRGraph loadCSR(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("loadCSR: cannot open " + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(csr_detail::Header)) {
+        close(fd);
+        throw std::runtime_error("loadCSR: bad file " + path);
+    }
+    size_t len = (size_t)st.st_size;
+    void* addr = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) throw std::runtime_error("loadCSR: mmap failed for " + path);
+
+    CSRGraph g;
+    g.mapAddr = addr;
+    g.mapLen = len;
+
+    const char* base = (const char*)addr;
+    csr_detail::Header h;
+    memcpy(&h, base, sizeof h);
+    if (memcmp(h.magic, csr_detail::MAGIC, 8) != 0)
+        throw std::runtime_error("loadCSR: not a CSR graph file " + path);
+
+    // every vertex and arc takes at least 4 bytes of the file, so these
+    // bounds keep the size arithmetic below from overflowing
+    if (h.n >= INT32_MAX || h.n > len || h.m > len) throw std::runtime_error("loadCSR: bad header in " + path);
+    size_t offsetBytes = (h.n + 1) * sizeof(int64_t);
+    size_t targetBytes = csr_detail::pad8(h.m * sizeof(int));
+    size_t need = sizeof h + offsetBytes + targetBytes + ((h.flags & 1) ? h.m * sizeof(int) : 0);
+    if (len < need) throw std::runtime_error("loadCSR: truncated file " + path);
+
+    g.n = (int)h.n;
+    g.m = (int64_t)h.m;
+    g.offsets = (const int64_t*)(base + sizeof h);
+    g.targets = (const int*)(base + sizeof h + offsetBytes);
+    g.weights = (h.flags & 1) ? (const int*)(base + sizeof h + offsetBytes + targetBytes) : nullptr;
+
+    // checked once here so that no algorithm indexes out of the mapping
+    bool ok = g.offsets[0] == 0 && g.offsets[g.n] == g.m;
+    for (int u = 0; u < g.n && ok; u++) ok = g.offsets[u] <= g.offsets[u + 1];
+    for (int64_t e = 0; e < g.m && ok; e++) ok = g.targets[e] >= 0 && g.targets[e] < g.n;
+    if (!ok) throw std::runtime_error("loadCSR: corrupt offsets or targets in " + path);
+    return g;
+}
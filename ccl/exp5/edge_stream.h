@@ -0,0 +1,157 @@
+// One-pass union-find over an undirected edge stream, for graphs whose edge
+// list does not fit in memory. Only O(V) state is kept: a parent and a rank
+// per vertex. Used by `./1 stream` (cycle check) and `./3 stream` (component
+// count); one pass answers both.
+//
+// Input is the same text format csr_convert reads: "u v [w]" per line, each
+// undirected edge listed once, '#' / '%' comment lines skipped. Pass "-" to
+// read stdin, so edges can be piped in. A repeated edge counts as a cycle.
+// Vertex ids must be in [0, INT_MAX), as csr_convert requires; a line with
+// any other id throws with its line number.
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+// Disjoint sets with union by rank and path halving; grows as ids appear.
+class DisjointSets {
+    std::vector<int> parent;
+    std::vector<uint8_t> rnk;
+
+public:
+    int64_t sets = 0;
+
+    void ensure(int v) {
+        if (v < (int)parent.size()) return;
+        size_t old = parent.size();
+        parent.resize((size_t)v + 1);
+        rnk.resize((size_t)v + 1, 0);
+        for (size_t i = old; i < parent.size(); i++) parent[i] = (int)i;
+        sets += (int64_t)(parent.size() - old);
+    }
+
+    int find(int x) {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    }
+
+    // false if u and v were already connected
+    bool unite(int u, int v) {
+        int a = find(u), b = find(v);
+        if (a == b) return false;
+        if (rnk[a] < rnk[b]) std::swap(a, b);
+        parent[b] = a;
+        if (rnk[a] == rnk[b]) rnk[a]++;
+        sets--;
+        return true;
+    }
+
+    int64_t size() const { return (int64_t)parent.size(); }
+    size_t bytes() const { return parent.capacity() * sizeof(int) + rnk.capacity(); }
+};
+
+struct StreamSummary {
+    int64_t vertices = 0;
+    int64_t edges = 0;
+    bool hasCycle = false;
+    int64_t components = 0;
+    int64_t bytesRead = 0;
+    size_t dsuBytes = 0;
+};
+
+inline long peakRssKb() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;   // kilobytes on Linux
+}
+
+// Reads `path` ("-" = stdin) in 1 MB chunks. n, if given, is the vertex count
+// (so isolated vertices past the largest id are counted as components).
+inline StreamSummary streamUnionFind(const std::string& path, int n = 0) {
+    FILE* in = path == "-" ? stdin : fopen(path.c_str(), "rb");
+    if (in == nullptr) throw std::runtime_error("streamUnionFind: cannot open " + path);
+
+    DisjointSets dsu;
+    if (n > 0) dsu.ensure(n - 1);
+    StreamSummary res;
+
+    const size_t CHUNK = 1 << 20;
+    std::vector<char> buf(CHUNK);
+    long long field[3];
+    int fields = 0;
+    long long cur = 0;
+    int64_t lineNo = 1;
+    bool inNumber = false, comment = false, lineStart = true, minus = false, negative = false;
+
+    // digits past INT_MAX saturate, so an overlong id cannot wrap around
+    auto endNumber = [&] {
+        if (fields < 3) field[fields++] = negative ? -cur : cur;
+        inNumber = false;
+    };
+    auto endLine = [&] {
+        if (fields >= 2) {
+            if (field[0] < 0 || field[1] < 0 || field[0] >= INT_MAX || field[1] >= INT_MAX) {
+                if (in != stdin) fclose(in);
+                throw std::runtime_error("streamUnionFind: " + path + ":" + std::to_string(lineNo) +
+                                         ": vertex id out of range");
+            }
+            int u = (int)field[0], v = (int)field[1];
+            dsu.ensure(u > v ? u : v);
+            if (!dsu.unite(u, v)) res.hasCycle = true;
+            res.edges++;
+        }
+        fields = 0;
+    };
+
+    size_t got;
+    while ((got = fread(buf.data(), 1, CHUNK, in)) > 0) {
+        res.bytesRead += (int64_t)got;
+        for (size_t i = 0; i < got; i++) {
+            char c = buf[i];
+            if (c == '\n') {
+                if (inNumber) endNumber();
+                minus = false;
+                if (!comment) endLine();
+                lineNo++;
+                comment = false;
+                lineStart = true;
+                continue;
+            }
+            if (comment) continue;
+            if (lineStart && (c == '#' || c == '%')) { comment = true; continue; }
+            lineStart = false;
+            if (c >= '0' && c <= '9') {
+                if (!inNumber) { cur = 0; negative = minus; }
+                cur = std::min<long long>(cur * 10 + (c - '0'), (long long)INT_MAX + 1);
+                inNumber = true;
+            } else {
+                if (inNumber) endNumber();
+                minus = c == '-';
+            }
+        }
+    }
+    if (inNumber) endNumber();
+    if (!comment) endLine();
+    if (in != stdin) fclose(in);
+
+    res.vertices = dsu.size();
+    res.components = dsu.sets;
+    res.dsuBytes = dsu.bytes();
+    return res;
+}
+
+inline void printStreamStats(const StreamSummary& s) {
+    fprintf(stderr, "vertices %lld, edges %lld, read %.1f MB, union-find %.1f MB, peak RSS %.1f MB\n",
+            (long long)s.vertices, (long long)s.edges, s.bytesRead / 1048576.0, s.dsuBytes / 1048576.0,
+            peakRssKb() / 1024.0);
+}
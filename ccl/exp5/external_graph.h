@@ -0,0 +1,163 @@
+// Semi-external access to a .csr file (csr_graph.h layout) for graphs whose
+// edges do not fit in memory. Only the offsets (8 bytes per vertex) are read
+// into RAM; the target array stays on disk and is streamed front to back in
+// large blocks, one sequential pass per BFS level / union-find pass. Kernels
+// keep their O(V) state (dist, parent, labels) in memory as usual.
+//
+// Reads use O_DIRECT when the file system supports it, so the graph does not
+// push the O(V) arrays out of the page cache; otherwise buffered reads with
+// sequential readahead, dropping each block from the cache once consumed.
+// A pass can be restricted to some blocks (e.g. those holding the current BFS
+// frontier), which turns late, sparse BFS levels into a few short reads.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include "csr_graph.h"
+#include "edge_stream.h"
+
+struct IoStats {
+    int64_t bytesRead = 0;
+    int64_t reads = 0;
+    int passes = 0;
+    int64_t blocksSkipped = 0;
+};
+
+class ExternalGraph {
+    static const size_t ALIGN = 4096;
+
+    struct FdGuard {
+        int fd;
+        ~FdGuard() {
+            if (fd >= 0) close(fd);
+        }
+        int release() {
+            int f = fd;
+            fd = -1;
+            return f;
+        }
+    };
+
+    int fd = -1;
+    bool direct = false;
+    int64_t targetsPos = 0;     // file position of targets[0]
+    int64_t blockEdges = 0;
+    char* buffer = nullptr;
+    size_t bufferBytes = 0;
+
+    // targets[first, last) into the buffer
+    const int* readBlock(int64_t first, int64_t last) {
+        int64_t begin = targetsPos + first * (int64_t)sizeof(int), end = targetsPos + last * (int64_t)sizeof(int);
+        int64_t from = direct ? begin & ~(int64_t)(ALIGN - 1) : begin;
+        int64_t length = end - from;
+        if (direct) length = (length + ALIGN - 1) & ~(int64_t)(ALIGN - 1);
+
+        int64_t got = 0;
+        while (got < end - from) {
+            ssize_t r = pread(fd, buffer + got, (size_t)(length - got), from + got);
+            if (r <= 0) throw std::runtime_error("ExternalGraph: read failed");
+            got += r;
+            stats.reads++;
+        }
+        stats.bytesRead += got;
+        if (!direct) posix_fadvise(fd, from, length, POSIX_FADV_DONTNEED);
+        return (const int*)(buffer + (begin - from));
+    }
+
+public:
+    int n = 0;
+    int64_t m = 0;
+    std::vector<int64_t> offsets;   // n + 1 entries, in memory
+    IoStats stats;
+
+    // blockBytes: how much of the target array one read covers
+    explicit ExternalGraph(const std::string& path, size_t blockBytes = 64 << 20) {
+        // the destructor does not run if this throws: the guards close
+        // whatever is open by then
+        FdGuard file{open(path.c_str(), O_RDONLY | O_DIRECT)};
+        direct = file.fd >= 0;
+        if (!direct) file.fd = open(path.c_str(), O_RDONLY);
+        if (file.fd < 0) throw std::runtime_error("ExternalGraph: cannot open " + path);
+
+        // the header and offsets are small and read once, without O_DIRECT
+        FdGuard second{direct ? open(path.c_str(), O_RDONLY) : -1};
+        int plain = direct ? second.fd : file.fd;
+        if (plain < 0) throw std::runtime_error("ExternalGraph: cannot open " + path);
+        csr_detail::Header h;
+        if (pread(plain, &h, sizeof h, 0) != (ssize_t)sizeof h || memcmp(h.magic, csr_detail::MAGIC, 8) != 0 ||
+            h.n >= (uint64_t)INT32_MAX)
+            throw std::runtime_error("ExternalGraph: not a CSR graph file " + path);
+        n = (int)h.n;
+        m = (int64_t)h.m;
+        offsets.resize(n + 1);
+        size_t offsetBytes = (n + 1) * sizeof(int64_t);
+        if (pread(plain, offsets.data(), offsetBytes, sizeof h) != (ssize_t)offsetBytes)
+            throw std::runtime_error("ExternalGraph: truncated file " + path);
+        targetsPos = (int64_t)(sizeof h + offsetBytes);
+        stats.bytesRead += (int64_t)(sizeof h + offsetBytes);
+
+        blockEdges = std::max<int64_t>(1, (int64_t)(blockBytes / sizeof(int)));
+        bufferBytes = blockEdges * sizeof(int) + 2 * ALIGN;
+        if (posix_memalign((void**)&buffer, ALIGN, bufferBytes) != 0)
+            throw std::runtime_error("ExternalGraph: out of memory");
+        if (!direct) posix_fadvise(file.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        fd = file.release();
+    }
+
+    ~ExternalGraph() {
+        free(buffer);
+        if (fd >= 0) close(fd);
+    }
+    ExternalGraph(const ExternalGraph&) = delete;
+    ExternalGraph& operator=(const ExternalGraph&) = delete;
+
+    bool directIo() const { return direct; }
+    int degree(int u) const { return (int)(offsets[u + 1] - offsets[u]); }
+    int64_t blocks() const { return (m + blockEdges - 1) / blockEdges; }
+
+    // Sets active[b] for every block holding part of u's neighbour list.
+    void markBlocks(std::vector<char>& active, int u) const {
+        if (degree(u) == 0) return;
+        for (int64_t b = offsets[u] / blockEdges; b <= (offsets[u + 1] - 1) / blockEdges; b++) active[b] = 1;
+    }
+
+    // One sequential pass: fn(u, targets, count) for every piece of a
+    // neighbour list, in vertex order. A list split by a block boundary
+    // arrives in two calls. With `active`, blocks not marked are not read.
+    template <class Fn>
+    void scan(Fn fn, const std::vector<char>* active = nullptr) {
+        stats.passes++;
+        for (int64_t b = 0; b < blocks(); b++) {
+            if (active && !(*active)[b]) {
+                stats.blocksSkipped++;
+                continue;
+            }
+            int64_t first = b * blockEdges, last = std::min(m, first + blockEdges);
+            const int* t = readBlock(first, last);
+            int u = (int)(std::upper_bound(offsets.begin(), offsets.end(), first) - offsets.begin()) - 1;
+            for (int64_t e = first; e < last; u++) {
+                int64_t end = std::min(offsets[u + 1], last);
+                if (end > e) fn(u, t + (e - first), (int)(end - e));
+                e = std::max(e, end);
+            }
+        }
+    }
+};
+
+inline void printIoStats(const ExternalGraph& g) {
+    const IoStats& s = g.stats;
+    double graphBytes = (double)g.m * sizeof(int);
+    fprintf(stderr, "%s I/O: %d passes, %lld reads, %.1f MB read (%.2fx the edge data), %lld blocks skipped, "
+            "peak RSS %.1f MB\n", g.directIo() ? "direct" : "buffered", s.passes, (long long)s.reads,
+            s.bytesRead / 1048576.0, graphBytes > 0 ? s.bytesRead / graphBytes : 0.0, (long long)s.blocksSkipped,
+            peakRssKb() / 1024.0);
+}
@@ -0,0 +1,123 @@
+// Small fork-join helpers for the parallel exp5 kernels (std::thread only,
+// so the files still build with a plain `g++ file.cpp`).
+//
+// Thread count defaults to the hardware concurrency and can be pinned with
+// the EXP5_THREADS environment variable.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+inline int numThreads() {
+    static int t = [] {
+        const char* env = getenv("EXP5_THREADS");
+        int n = env ? atoi(env) : (int)std::thread::hardware_concurrency();
+        return std::max(1, n);
+    }();
+    return t;
+}
+
+// Persistent workers, so per-level dispatch in BFS-like loops costs a wakeup
+// rather than a thread spawn. run(fn) calls fn(tid) on every worker
+// (the caller acts as tid 0) and returns once all of them are done.
+class ThreadPool {
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable wake, done;
+    std::function<void(int)> job;
+    uint64_t generation = 0;
+    int pending = 0;
+    bool stop = false;
+
+    void loop(int tid) {
+        uint64_t seen = 0;
+        while (true) {
+            std::unique_lock<std::mutex> lock(mtx);
+            wake.wait(lock, [&] { return stop || generation != seen; });
+            if (stop) return;
+            seen = generation;
+            lock.unlock();
+
+            job(tid);
+
+            lock.lock();
+            if (--pending == 0) done.notify_one();
+        }
+    }
+
+public:
+    explicit ThreadPool(int n) {
+        for (int t = 1; t < n; t++)
+            workers.emplace_back([this, t] { loop(t); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto& w : workers) w.join();
+    }
+
+    int size() const { return (int)workers.size() + 1; }
+
+    void run(const std::function<void(int)>& fn) {
+        if (workers.empty()) { fn(0); return; }
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            job = fn;
+            pending = (int)workers.size();
+            generation++;
+        }
+        wake.notify_all();
+        fn(0);
+        std::unique_lock<std::mutex> lock(mtx);
+        done.wait(lock, [&] { return pending == 0; });
+    }
+};
+
+inline std::unique_ptr<ThreadPool>& poolSlot() {
+    static std::unique_ptr<ThreadPool> pool;
+    return pool;
+}
+
+inline ThreadPool& threadPool() {
+    auto& pool = poolSlot();
+    if (!pool) pool.reset(new ThreadPool(numThreads()));
+    return *pool;
+}
+
+// Replaces the shared pool, e.g. for thread-scaling benchmarks.
+inline void setThreads(int n) {
+    poolSlot().reset();
+    poolSlot().reset(new ThreadPool(std::max(1, n)));
+}
+
+// fn(tid, i) for every i in [begin, end). Work is handed out in `grain`-sized
+// chunks from a shared counter; small ranges run inline on the caller.
+template <class F>
+void parallelFor(int64_t begin, int64_t end, F&& fn, int64_t grain = 1024) {
+    ThreadPool& pool = threadPool();
+    if (end - begin <= grain || pool.size() == 1) {
+        for (int64_t i = begin; i < end; i++) fn(0, i);
+        return;
+    }
+    std::atomic<int64_t> next(begin);
+    pool.run([&](int tid) {
+        while (true) {
+            int64_t lo = next.fetch_add(grain, std::memory_order_relaxed);
+            if (lo >= end) break;
+            int64_t hi = std::min(end, lo + grain);
+            for (int64_t i = lo; i < hi; i++) fn(tid, i);
+        }
+    });
+}
@@ -0,0 +1,52 @@
+// Hardware cache-miss counter for the benchmark modes, via perf_event_open.
+// Counts last-level cache misses of this thread (and any threads it starts
+// afterwards). Where perf events are not allowed (containers, VMs,
+// perf_event_paranoid > 2) available() is false and count() returns -1, so
+// callers can print "n/a" and still run.
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+class LlcMissCounter {
+    int fd = -1;
+
+public:
+    LlcMissCounter() {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof attr);
+        attr.size = sizeof attr;
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    ~LlcMissCounter() { if (fd >= 0) close(fd); }
+    LlcMissCounter(const LlcMissCounter&) = delete;
+    LlcMissCounter& operator=(const LlcMissCounter&) = delete;
+
+    bool available() const { return fd >= 0; }
+
+    void start() {
+        if (fd < 0) return;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    // misses since start(), or -1 if unavailable
+    int64_t count() {
+        if (fd < 0) return -1;
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        int64_t value = 0;
+        if (read(fd, &value, sizeof value) != (ssize_t)sizeof value) return -1;
+        return value;
+    }
+};
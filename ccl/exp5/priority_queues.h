@@ -0,0 +1,190 @@
+// Min-priority queues keyed by vertex, for Dijkstra-style searches.
+//
+// Every queue has the same shape so it can be passed as a template argument:
+//   Queue(int n, Dist maxWeight)   maxWeight is only used by DialQueue
+//   bool empty() const
+//   void push(int v, Dist d)       insert v, or lower its key if already queued
+//   pair<Dist, int> pop()          remove and return the minimum {d, v}
+//
+// Lazy queues (BinaryHeapLazy, RadixHeap, DialQueue) keep stale duplicates
+// instead of doing decrease-key, so callers still skip entries whose d is
+// larger than the settled distance. RadixHeap and DialQueue are monotone:
+// a pushed key must never be smaller than the last popped one, which holds
+// for Dijkstra with non-negative weights.
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+// std::priority_queue with lazy deletion: the original exp5/6.cpp queue.
+// Size grows with the number of relaxations (E), not V.
+template <class D>
+class BinaryHeapLazy {
+    std::priority_queue<std::pair<D, int>, std::vector<std::pair<D, int>>, std::greater<std::pair<D, int>>> pq;
+
+public:
+    using Dist = D;
+    BinaryHeapLazy(int, D) {}
+    bool empty() const { return pq.empty(); }
+    void push(int v, D d) { pq.emplace(d, v); }
+    std::pair<D, int> pop() {
+        auto top = pq.top();
+        pq.pop();
+        return top;
+    }
+};
+
+// Indexed d-ary heap with real decrease-key: at most one entry per vertex,
+// and a wider node means a shallower heap and fewer cache misses on sift-down.
+template <class D, int ARITY = 4>
+class IndexedDaryHeap {
+    std::vector<int> heap;  // vertices, heap ordered by key
+    std::vector<int> pos;   // pos[v] = index in heap, -1 if not queued
+    std::vector<D> key;
+
+    void place(int i, int v) {
+        heap[i] = v;
+        pos[v] = i;
+    }
+
+    void siftUp(int i) {
+        int v = heap[i];
+        while (i > 0) {
+            int p = (i - 1) / ARITY;
+            if (key[heap[p]] <= key[v]) break;
+            place(i, heap[p]);
+            i = p;
+        }
+        place(i, v);
+    }
+
+    void siftDown(int i) {
+        int v = heap[i];
+        int size = (int)heap.size();
+        while (true) {
+            int first = i * ARITY + 1;
+            if (first >= size) break;
+            int last = first + ARITY < size ? first + ARITY : size;
+            int best = first;
+            for (int c = first + 1; c < last; c++)
+                if (key[heap[c]] < key[heap[best]]) best = c;
+            if (key[heap[best]] >= key[v]) break;
+            place(i, heap[best]);
+            i = best;
+        }
+        place(i, v);
+    }
+
+public:
+    using Dist = D;
+    IndexedDaryHeap(int n, D) : pos(n, -1), key(n) {}
+    bool empty() const { return heap.empty(); }
+    D topKey() const { return key[heap[0]]; }
+
+    // O(size) reset, so a heap can be reused across searches without
+    // touching all n positions
+    void clear() {
+        for (int v : heap) pos[v] = -1;
+        heap.clear();
+    }
+
+    void push(int v, D d) {
+        if (pos[v] == -1) {
+            key[v] = d;
+            heap.push_back(v);
+            siftUp((int)heap.size() - 1);
+        } else if (d < key[v]) {
+            key[v] = d;
+            siftUp(pos[v]);
+        }
+    }
+
+    std::pair<D, int> pop() {
+        int top = heap[0];
+        pos[top] = -1;
+        int last = heap.back();
+        heap.pop_back();
+        if (!heap.empty()) {
+            heap[0] = last;
+            siftDown(0);
+        }
+        return {key[top], top};
+    }
+};
+
+// Monotone radix heap (Ahuja, Mehlhorn, Orlin, Tarjan): bucket i holds keys
+// whose highest bit differing from the last popped key is bit i-1, so each
+// entry moves down at most 64 times in total.
+template <class D>
+class RadixHeap {
+    std::vector<std::pair<D, int>> buckets[65];
+    uint64_t last = 0;
+    size_t count = 0;
+
+    static int bucketOf(uint64_t x, uint64_t last) {
+        return x == last ? 0 : 64 - __builtin_clzll(x ^ last);
+    }
+
+public:
+    using Dist = D;
+    RadixHeap(int, D) {}
+    bool empty() const { return count == 0; }
+
+    void push(int v, D d) {
+        buckets[bucketOf((uint64_t)d, last)].emplace_back(d, v);
+        count++;
+    }
+
+    std::pair<D, int> pop() {
+        if (buckets[0].empty()) {
+            int i = 1;
+            while (buckets[i].empty()) i++;
+            uint64_t mn = (uint64_t)buckets[i][0].first;
+            for (auto& p : buckets[i])
+                if ((uint64_t)p.first < mn) mn = (uint64_t)p.first;
+            last = mn;
+            for (auto& p : buckets[i])
+                buckets[bucketOf((uint64_t)p.first, last)].push_back(p);
+            buckets[i].clear();
+        }
+        auto top = buckets[0].back();
+        buckets[0].pop_back();
+        count--;
+        return top;
+    }
+};
+
+// Dial's bucket queue for small integer weights: maxWeight + 1 circular
+// buckets cover every key in [current, current + maxWeight], so push and pop
+// are O(1) plus the walk over empty buckets.
+template <class D>
+class DialQueue {
+    std::vector<std::vector<int>> buckets;
+    size_t cur = 0;
+    D curKey = 0;
+    size_t count = 0;
+
+public:
+    using Dist = D;
+    DialQueue(int, D maxWeight) : buckets((size_t)maxWeight + 1) {}
+    bool empty() const { return count == 0; }
+
+    void push(int v, D d) {
+        buckets[(size_t)(d % (D)buckets.size())].push_back(v);
+        count++;
+    }
+
+    std::pair<D, int> pop() {
+        while (buckets[cur].empty()) {
+            cur = cur + 1 == buckets.size() ? 0 : cur + 1;
+            curKey++;
+        }
+        int v = buckets[cur].back();
+        buckets[cur].pop_back();
+        count--;
+        return {curKey, v};
+    }
+};
@@ -0,0 +1,183 @@
+// Vertex relabelling for locality. The exp5 kernels index dist / par /
+// visited / colour arrays by neighbour id, so with arbitrary ids nearly every
+// edge touches a different cache line. Giving vertices that are visited
+// together nearby ids turns those accesses into mostly-sequential ones.
+//
+//   rcmOrder         reverse Cuthill-McKee: BFS order from a low-degree vertex,
+//                    neighbours by increasing degree, reversed. Small
+//                    bandwidth; best on mesh / road-like graphs.
+//   degreeSortOrder  all vertices by decreasing degree. Hubs, which most
+//                    edges point at, share a few hot cache lines.
+//   hubSortOrder     only the hubs (degree above average) are moved to the
+//                    front, sorted; everyone else keeps their relative order,
+//                    so any locality already in the input survives.
+//
+// applyPermutation builds the relabelled graph; a result computed on it is
+// indexed by new ids, and toOriginalOrder / the oldId map bring it back.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <vector>
+#include "csr_graph.h"
+#include "bench_graphs.h"
+#include "perf_counter.h"
+
+struct Permutation {
+    std::vector<int> newId;   // newId[old vertex] = its label in the reordered graph
+    std::vector<int> oldId;   // oldId[new vertex] = original label (the inverse)
+};
+
+// order[i] = old id of the vertex that gets new id i
+inline Permutation permutationFromOrder(std::vector<int> order) {
+    Permutation p;
+    p.newId.resize(order.size());
+    for (size_t i = 0; i < order.size(); i++) p.newId[order[i]] = (int)i;
+    p.oldId = std::move(order);
+    return p;
+}
+
+// Uniformly random labels: how ids look in a graph whose ids carry no meaning.
+inline Permutation randomOrder(const CSRGraph& g, uint64_t seed = 7) {
+    std::vector<int> order(g.n);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937_64 rng(seed);
+    std::shuffle(order.begin(), order.end(), rng);
+    return permutationFromOrder(std::move(order));
+}
+
+inline Permutation rcmOrder(const CSRGraph& g) {
+    int n = g.n;
+    std::vector<int> byDegree(n), order, scratch;
+    std::iota(byDegree.begin(), byDegree.end(), 0);
+    std::stable_sort(byDegree.begin(), byDegree.end(),
+                     [&](int a, int b) { return g.degree(a) < g.degree(b); });
+    std::vector<char> seen(n, 0);
+    order.reserve(n);
+
+    // each component starts at its lowest-degree vertex
+    for (int root : byDegree) {
+        if (seen[root]) continue;
+        seen[root] = 1;
+        size_t head = order.size();
+        order.push_back(root);
+        while (head < order.size()) {
+            int u = order[head++];
+            scratch.clear();
+            for (int v : g.neighbors(u))
+                if (!seen[v]) { seen[v] = 1; scratch.push_back(v); }
+            std::sort(scratch.begin(), scratch.end(), [&](int a, int b) {
+                return g.degree(a) != g.degree(b) ? g.degree(a) < g.degree(b) : a < b;
+            });
+            order.insert(order.end(), scratch.begin(), scratch.end());
+        }
+    }
+    std::reverse(order.begin(), order.end());
+    return permutationFromOrder(std::move(order));
+}
+
+inline Permutation degreeSortOrder(const CSRGraph& g) {
+    std::vector<int> order(g.n);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return g.degree(a) > g.degree(b); });
+    return permutationFromOrder(std::move(order));
+}
+
+inline Permutation hubSortOrder(const CSRGraph& g) {
+    double average = g.n ? (double)g.m / g.n : 0;
+    std::vector<int> order, rest;
+    for (int u = 0; u < g.n; u++) (g.degree(u) > average ? order : rest).push_back(u);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return g.degree(a) > g.degree(b); });
+    order.insert(order.end(), rest.begin(), rest.end());
+    return permutationFromOrder(std::move(order));
+}
+
+// Relabelled copy of g; every neighbour list is sorted by new id (weights
+// follow their edges), so a scan of a list walks memory forwards.
+inline CSRGraph applyPermutation(const CSRGraph& g, const Permutation& p) {
+    CSRGraph h;
+    h.n = g.n;
+    h.m = g.m;
+    h.offsetBuf.assign(g.n + 1, 0);
+    for (int v = 0; v < g.n; v++) h.offsetBuf[v + 1] = h.offsetBuf[v] + g.degree(p.oldId[v]);
+    h.targetBuf.resize(g.m);
+    if (g.weighted()) h.weightBuf.resize(g.m);
+
+    std::vector<std::pair<int, int>> list;
+    for (int v = 0; v < g.n; v++) {
+        int u = p.oldId[v];
+        list.clear();
+        for (int64_t e = g.offsets[u]; e < g.offsets[u + 1]; e++)
+            list.push_back({p.newId[g.targets[e]], g.weighted() ? g.weights[e] : 0});
+        std::sort(list.begin(), list.end());
+        int64_t at = h.offsetBuf[v];
+        for (auto& [t, w] : list) {
+            h.targetBuf[at] = t;
+            if (g.weighted()) h.weightBuf[at] = w;
+            at++;
+        }
+    }
+    h.adoptBuffers();
+    return h;
+}
+
+// result[new id] -> result[old id]
+template <class T>
+std::vector<T> toOriginalOrder(const std::vector<T>& result, const Permutation& p) {
+    std::vector<T> out(result.size());
+    for (size_t v = 0; v < result.size(); v++) out[p.oldId[v]] = result[v];
+    return out;
+}
+
+// Times kernel(graph, source) on g as given and under each ordering, with
+// LLC misses where perf events are available. The kernel returns a per-vertex
+// result (indexed by the ids of the graph it was given), which is mapped back
+// and checked against the original run; any other size is compared as is.
+// Source is g's highest-degree vertex.
+template <class Kernel>
+void reorderReport(const char* name, const CSRGraph& g, Kernel kernel) {
+    int source = 0;
+    for (int u = 0; u < g.n; u++)
+        if (g.degree(u) > g.degree(source)) source = u;
+
+    LlcMissCounter llc;
+    printf("%s: n=%d m=%lld\n", name, g.n, (long long)g.m);
+    printf("  %-12s %10s %10s %14s %9s\n", "order", "build ms", "run ms", "LLC misses", "speedup");
+
+    auto measure = [&](const CSRGraph& h, int s, int64_t& misses, double& ms) {
+        llc.start();
+        Timer t;
+        auto r = kernel(h, s);
+        ms = t.ms();
+        misses = llc.count();
+        return r;
+    };
+    auto printRow = [&](const char* order, double buildMs, double ms, int64_t misses, double base, bool ok) {
+        char missText[32];
+        if (misses < 0) snprintf(missText, sizeof missText, "n/a");
+        else snprintf(missText, sizeof missText, "%lld", (long long)misses);
+        printf("  %-12s %10.1f %10.1f %14s %8.2fx  %s\n", order, buildMs, ms, missText, base / ms,
+               ok ? "ok" : "MISMATCH");
+    };
+
+    int64_t misses;
+    double baseMs;
+    auto ref = measure(g, source, misses, baseMs);
+    printRow("original", 0, baseMs, misses, baseMs, true);
+
+    struct Ordering { const char* name; Permutation (*make)(const CSRGraph&); };
+    for (Ordering o : {Ordering{"rcm", rcmOrder}, Ordering{"degree", degreeSortOrder},
+                       Ordering{"hub", hubSortOrder}}) {
+        Timer build;
+        Permutation p = o.make(g);
+        CSRGraph h = applyPermutation(g, p);
+        double buildMs = build.ms();
+        double ms;
+        auto r = measure(h, p.newId[source], misses, ms);
+        bool ok = (int)r.size() == g.n ? toOriginalOrder(r, p) == ref : r == ref;
+        printRow(o.name, buildMs, ms, misses, baseMs, ok);
+    }
+}
@@ -1,19 +1,34 @@
 #include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+#include "node_pool.h"
+#include "bench_util.h"
+#include "frozen_search.h"
 using namespace std;
 
-struct Node {
+// Ref = PoolRef (32-bit pool index) or HeapRef (new / delete)
+template <template <class> class Ref>
+struct BasicNode {
     int data;
-    Node* left;
-    Node* right;
-    Node(int val) {
+    Ref<BasicNode> left;
+    Ref<BasicNode> right;
+    BasicNode(int val) {
         data = val;
         left = right = nullptr;
     }
 };
 
-Node* insert(Node* root, int key) {
+using Node = BasicNode<PoolRef>;
+using NodeRef = PoolRef<Node>;
+
+template <class NodeRef>
+NodeRef insert(NodeRef root, int key) {
     if (root == nullptr)
-        return new Node(key);
+        return NodeRef::make(key);
     if (key < root->data)
         root->left = insert(root->left, key);
     else if (key > root->data)
@@ -21,20 +36,23 @@ Node* insert(Node* root, int key) {
     return root;
 }
 
-bool search(Node* root, int key) {
+template <class NodeRef>
+bool search(NodeRef root, int key) {
     if (root == nullptr) return false;
     if (root->data == key) return true;
     if (key < root->data) return search(root->left, key);
     return search(root->right, key);
 }
 
-Node* findMin(Node* root) {
+template <class NodeRef>
+NodeRef findMin(NodeRef root) {
     while (root->left != nullptr)
         root = root->left;
     return root;
 }
 
-Node* deleteNode(Node* root, int key) {
+template <class NodeRef>
+NodeRef deleteNode(NodeRef root, int key) {
     if (root == nullptr) return nullptr;
     if (key < root->data)
         root->left = deleteNode(root->left, key);
@@ -42,30 +60,154 @@ Node* deleteNode(Node* root, int key) {
         root->right = deleteNode(root->right, key);
     else {
         if (root->left == nullptr) {
-            Node* temp = root->right;
-            delete root;
+            NodeRef temp = root->right;
+            root.release();
             return temp;
         } else if (root->right == nullptr) {
-            Node* temp = root->left;
-            delete root;
+            NodeRef temp = root->left;
+            root.release();
             return temp;
         }
-        Node* temp = findMin(root->right);
+        NodeRef temp = findMin(root->right);
         root->data = temp->data;
         root->right = deleteNode(root->right, temp->data);
     }
     return root;
 }
 
-void inorder(Node* root) {
+// frees every node one by one (what a pool-less tree has to do)
+template <class NodeRef>
+void freeTree(NodeRef root) {
+    if (root == nullptr) return;
+    freeTree(root->left);
+    freeTree(root->right);
+    root.release();
+}
+
+template <class NodeRef>
+void inorder(NodeRef root) {
     if (root == nullptr) return;
     inorder(root->left);
     cout << root->data << " ";
     inorder(root->right);
 }
 
-int main() {
-    Node* root = nullptr;
+// n random inserts, n lookups (half hits), n/2 deletes, then teardown; with
+// pooled indices and with new / delete. ./1 bench [n]
+template <class NodeRef>
+struct BenchTree {
+    static const bool erases = true, copies = false, pooled = NodeRef::pooled;
+    NodeRef root = nullptr;
+    void insert(int k) { root = ::insert(root, k); }
+    bool contains(int k) const { return search(root, k); }
+    void erase(int k) { root = deleteNode(root, k); }
+    bool valid() const { return true; }
+    size_t poolBytes() const {
+        if constexpr (NodeRef::pooled) return NodeRef::pool().bytes();
+        return 0;
+    }
+    void release() {
+        freeTree(root);
+        root = nullptr;
+    }
+    // every node of this type, in every tree
+    void dropPool() {
+        NodeRef::releaseAll();
+        root = nullptr;
+    }
+};
+
+void benchmark(int n) {
+    vector<int> keys = randomKeys(n);
+    printf("BST, %d random keys\n", n);
+    runPoolBenchmark<BenchTree<PoolRef<BasicNode<PoolRef>>>>("pool", keys);
+    runPoolBenchmark<BenchTree<HeapRef<BasicNode<HeapRef>>>>("new/delete", keys);
+}
+
+// keys in order, appended to out
+template <class NodeRef>
+void collectKeys(NodeRef root, vector<int>& out) {
+    if (root == nullptr) return;
+    collectKeys(root->left, out);
+    out.push_back(root->data);
+    collectKeys(root->right, out);
+}
+
+// Read-only snapshot of the tree in one inorder pass, in a flat layout
+// (EytzingerSet or VebSet from frozen_search.h); the tree is left as is.
+template <class Layout, class NodeRef>
+Layout freeze(NodeRef root) {
+    vector<int> keys;
+    collectKeys(root, keys);
+    return Layout(keys);
+}
+
+// Lookups in the pointer tree vs its frozen Eytzinger and van Emde Boas
+// snapshots (one at a time and batched) and binary search over the sorted
+// keys, at each n given (default 1M and 10M; 100M needs ~4 GB).
+// ./1 layout [n ...]
+void layoutBenchmark(int n) {
+    vector<int> keys = randomKeys(n);
+    NodeRef root = nullptr;
+    for (int k : keys) root = insert(root, k);
+
+    Timer tf;
+    EytzingerSet eyt = freeze<EytzingerSet>(root);
+    double eytMs = tf.ms();
+    Timer tv;
+    VebSet veb = freeze<VebSet>(root);
+    double vebMs = tv.ms();
+    vector<int> sorted;
+    collectKeys(root, sorted);
+
+    int q = min(n, 10000000);
+    vector<int> queries(q);
+    for (int i = 0; i < q; i++) queries[i] = keys[i] + (i & 1);   // half hits
+    printf("n = %d, %d lookups; Eytzinger built in %.0f ms (%.1f MB), vEB in %.0f ms (%.1f MB)\n", n, q, eytMs,
+           eyt.bytes() / 1048576.0, vebMs, veb.bytes() / 1048576.0);
+
+    unique_ptr<bool[]> got(new bool[q]);
+    auto report = [&](const char* name, auto lookup) {
+        fill(got.get(), got.get() + q, false);
+        Timer t;
+        lookup(got.get());
+        double ms = t.ms();
+        bool ok = true;
+        for (int i = 0; i < q; i++) ok = ok && got[i] == !(i & 1);
+        printf("  %-22s %8.2f M lookups/s  %s\n", name, mops(q, ms), ok ? "ok" : "WRONG");
+    };
+    report("pointer tree", [&](bool* out) {
+        for (int i = 0; i < q; i++) out[i] = search(root, queries[i]);
+    });
+    report("sorted array", [&](bool* out) {
+        for (int i = 0; i < q; i++) out[i] = binary_search(sorted.begin(), sorted.end(), queries[i]);
+    });
+    report("eytzinger", [&](bool* out) {
+        for (int i = 0; i < q; i++) out[i] = eyt.contains(queries[i]);
+    });
+    report("eytzinger, batched", [&](bool* out) { eyt.containsBatch(queries.data(), q, out); });
+    report("van emde boas", [&](bool* out) {
+        for (int i = 0; i < q; i++) out[i] = veb.contains(queries[i]);
+    });
+    report("van emde boas, batched", [&](bool* out) { veb.containsBatch(queries.data(), q, out); });
+    NodeRef::releaseAll();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "bench") {
+        benchmark(argc > 2 ? atoi(argv[2]) : 4000000);
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "layout") {
+        if (argc == 2) {
+            layoutBenchmark(1000000);
+            layoutBenchmark(10000000);
+        }
+        for (int i = 2; i < argc; i++) layoutBenchmark(atoi(argv[i]));
+        return 0;
+    }
+
+    NodeRef root = nullptr;
     root = insert(root, 50);
     root = insert(root, 30);
     root = insert(root, 70);
@@ -85,4 +227,4 @@ int main() {
     cout << endl;
 
     return 0;
-}
\ No newline at end of file
+}
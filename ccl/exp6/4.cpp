@@ -1,15 +1,34 @@
 #include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <sstream>
+#include "bench_util.h"
+#include "node_search.h"
+#include "node_pool.h"
+#include "buffer_pool.h"
+#include "fork_join.h"
 using namespace std;
 
-const int T = 3;
-
+// T = minimum degree: every node but the root holds T - 1 .. 2T - 1 keys.
+// Keys and values sit in separate arrays so the search only touches keys;
+// the key array is padded for the SIMD search (node_search.h) and starts on
+// a cache line. Ref = HeapRef (new / delete) or PageRef (pages of a file,
+// see PagedBTree).
+template <class Key, class Value, int T, template <class> class Ref = HeapRef>
 struct BTreeNode {
-    int keys[2 * T - 1];
-    BTreeNode* children[2 * T];
+    static const int MAX_KEYS = 2 * T - 1;
+
+    alignas(64) Key keys[node_search::keySlots(MAX_KEYS)];
+    Value values[MAX_KEYS];
+    Ref<BTreeNode> children[2 * T];
     int n;
     bool leaf;
 
-    BTreeNode(bool isLeaf) {
+    BTreeNode(bool isLeaf) : keys() {
         leaf = isLeaf;
         n = 0;
         for (int i = 0; i < 2 * T; i++)
@@ -17,15 +36,35 @@ struct BTreeNode {
     }
 };
 
+// largest T whose node fits in `bytes` (at least 2), e.g. a cache line
+// multiple or a page
+template <class Key, class Value, template <class> class Ref = HeapRef>
+constexpr int degreeFor(size_t bytes) {
+    int t = 2;
+    while (sizeof(Key) * node_search::keySlots(2 * (t + 1) - 1) + sizeof(Value) * (2 * (t + 1) - 1) +
+               sizeof(Ref<char>) * 2 * (t + 1) + 2 * sizeof(int) <= bytes)
+        t++;
+    return t;
+}
+
+// Map with unique keys; inserting a present key replaces its value.
+template <class Key, class Value, int T, template <class> class Ref = HeapRef>
 class BTree {
-    BTreeNode* root;
+public:
+    using Node = ::BTreeNode<Key, Value, T, Ref>;
+    using NodeRef = Ref<Node>;
 
-    void splitChild(BTreeNode* parent, int i, BTreeNode* child) {
-        BTreeNode* newNode = new BTreeNode(child->leaf);
+private:
+    NodeRef root;
+
+    void splitChild(NodeRef parent, int i, NodeRef child) {
+        NodeRef newNode = NodeRef::make(child->leaf);
         newNode->n = T - 1;
 
-        for (int j = 0; j < T - 1; j++)
+        for (int j = 0; j < T - 1; j++) {
             newNode->keys[j] = child->keys[j + T];
+            newNode->values[j] = child->values[j + T];
+        }
 
         if (!child->leaf)
             for (int j = 0; j < T; j++)
@@ -37,33 +76,43 @@ class BTree {
             parent->children[j + 1] = parent->children[j];
         parent->children[i + 1] = newNode;
 
-        for (int j = parent->n - 1; j >= i; j--)
+        for (int j = parent->n - 1; j >= i; j--) {
             parent->keys[j + 1] = parent->keys[j];
+            parent->values[j + 1] = parent->values[j];
+        }
         parent->keys[i] = child->keys[T - 1];
+        parent->values[i] = child->values[T - 1];
         parent->n++;
     }
 
-    void insertNonFull(BTreeNode* node, int key) {
-        int i = node->n - 1;
+    void insertNonFull(NodeRef node, const Key& key, const Value& value) {
+        int i = findKey(node, key);
+        if (i < node->n && node->keys[i] == key) {
+            node->values[i] = value;
+            return;
+        }
         if (node->leaf) {
-            while (i >= 0 && node->keys[i] > key) {
-                node->keys[i + 1] = node->keys[i];
-                i--;
+            for (int j = node->n; j > i; j--) {
+                node->keys[j] = node->keys[j - 1];
+                node->values[j] = node->values[j - 1];
             }
-            node->keys[i + 1] = key;
+            node->keys[i] = key;
+            node->values[i] = value;
             node->n++;
         } else {
-            while (i >= 0 && node->keys[i] > key) i--;
-            i++;
             if (node->children[i]->n == 2 * T - 1) {
                 splitChild(node, i, node->children[i]);
+                if (node->keys[i] == key) {
+                    node->values[i] = value;
+                    return;
+                }
                 if (node->keys[i] < key) i++;
             }
-            insertNonFull(node->children[i], key);
+            insertNonFull(node->children[i], key, value);
         }
     }
 
-    void traverse(BTreeNode* node) {
+    void traverse(NodeRef node) {
         int i;
         for (i = 0; i < node->n; i++) {
             if (!node->leaf) traverse(node->children[i]);
@@ -72,81 +121,97 @@ class BTree {
         if (!node->leaf) traverse(node->children[i]);
     }
 
-    int findKey(BTreeNode* node, int key) {
-        int idx = 0;
-        while (idx < node->n && node->keys[idx] < key) idx++;
-        return idx;
+    // first index with keys[idx] >= key
+    int findKey(NodeRef node, const Key& key) const {
+        return node_search::lowerBound(node->keys, node->n, key);
     }
 
-    void removeFromLeaf(BTreeNode* node, int idx) {
-        for (int i = idx + 1; i < node->n; i++)
+    void removeFromLeaf(NodeRef node, int idx) {
+        for (int i = idx + 1; i < node->n; i++) {
             node->keys[i - 1] = node->keys[i];
+            node->values[i - 1] = node->values[i];
+        }
         node->n--;
     }
 
-    int getPredecessor(BTreeNode* node, int idx) {
-        BTreeNode* cur = node->children[idx];
+    // rightmost leaf entry of the subtree left of keys[idx]
+    NodeRef getPredecessor(NodeRef node, int idx) {
+        NodeRef cur = node->children[idx];
         while (!cur->leaf) cur = cur->children[cur->n];
-        return cur->keys[cur->n - 1];
+        return cur;
     }
 
-    int getSuccessor(BTreeNode* node, int idx) {
-        BTreeNode* cur = node->children[idx + 1];
+    // leftmost leaf entry of the subtree right of keys[idx]
+    NodeRef getSuccessor(NodeRef node, int idx) {
+        NodeRef cur = node->children[idx + 1];
         while (!cur->leaf) cur = cur->children[0];
-        return cur->keys[0];
+        return cur;
     }
 
-    void merge(BTreeNode* node, int idx) {
-        BTreeNode* child = node->children[idx];
-        BTreeNode* sibling = node->children[idx + 1];
+    void merge(NodeRef node, int idx) {
+        NodeRef child = node->children[idx];
+        NodeRef sibling = node->children[idx + 1];
 
         child->keys[T - 1] = node->keys[idx];
-        for (int i = 0; i < sibling->n; i++)
+        child->values[T - 1] = node->values[idx];
+        for (int i = 0; i < sibling->n; i++) {
             child->keys[i + T] = sibling->keys[i];
+            child->values[i + T] = sibling->values[i];
+        }
         if (!child->leaf)
             for (int i = 0; i <= sibling->n; i++)
                 child->children[i + T] = sibling->children[i];
 
-        for (int i = idx + 1; i < node->n; i++)
+        for (int i = idx + 1; i < node->n; i++) {
             node->keys[i - 1] = node->keys[i];
+            node->values[i - 1] = node->values[i];
+        }
         for (int i = idx + 2; i <= node->n; i++)
             node->children[i - 1] = node->children[i];
 
         child->n += sibling->n + 1;
         node->n--;
-        delete sibling;
+        sibling.release();
     }
 
-    void borrowFromPrev(BTreeNode* node, int idx) {
-        BTreeNode* child = node->children[idx];
-        BTreeNode* sibling = node->children[idx - 1];
+    void borrowFromPrev(NodeRef node, int idx) {
+        NodeRef child = node->children[idx];
+        NodeRef sibling = node->children[idx - 1];
 
-        for (int i = child->n - 1; i >= 0; i--)
+        for (int i = child->n - 1; i >= 0; i--) {
             child->keys[i + 1] = child->keys[i];
+            child->values[i + 1] = child->values[i];
+        }
         if (!child->leaf)
             for (int i = child->n; i >= 0; i--)
                 child->children[i + 1] = child->children[i];
 
         child->keys[0] = node->keys[idx - 1];
+        child->values[0] = node->values[idx - 1];
         if (!child->leaf)
             child->children[0] = sibling->children[sibling->n];
 
         node->keys[idx - 1] = sibling->keys[sibling->n - 1];
+        node->values[idx - 1] = sibling->values[sibling->n - 1];
         child->n++;
         sibling->n--;
     }
 
-    void borrowFromNext(BTreeNode* node, int idx) {
-        BTreeNode* child = node->children[idx];
-        BTreeNode* sibling = node->children[idx + 1];
+    void borrowFromNext(NodeRef node, int idx) {
+        NodeRef child = node->children[idx];
+        NodeRef sibling = node->children[idx + 1];
 
         child->keys[child->n] = node->keys[idx];
+        child->values[child->n] = node->values[idx];
         if (!child->leaf)
             child->children[child->n + 1] = sibling->children[0];
 
         node->keys[idx] = sibling->keys[0];
-        for (int i = 1; i < sibling->n; i++)
+        node->values[idx] = sibling->values[0];
+        for (int i = 1; i < sibling->n; i++) {
             sibling->keys[i - 1] = sibling->keys[i];
+            sibling->values[i - 1] = sibling->values[i];
+        }
         if (!sibling->leaf)
             for (int i = 1; i <= sibling->n; i++)
                 sibling->children[i - 1] = sibling->children[i];
@@ -155,7 +220,7 @@ class BTree {
         sibling->n--;
     }
 
-    void fill(BTreeNode* node, int idx) {
+    void fill(NodeRef node, int idx) {
         if (idx != 0 && node->children[idx - 1]->n >= T)
             borrowFromPrev(node, idx);
         else if (idx != node->n && node->children[idx + 1]->n >= T)
@@ -166,23 +231,27 @@ class BTree {
         }
     }
 
-    void removeFromNonLeaf(BTreeNode* node, int idx) {
-        int key = node->keys[idx];
+    void removeFromNonLeaf(NodeRef node, int idx) {
+        Key key = node->keys[idx];
         if (node->children[idx]->n >= T) {
-            int pred = getPredecessor(node, idx);
-            node->keys[idx] = pred;
-            remove(node->children[idx], pred);
+            NodeRef pred = getPredecessor(node, idx);
+            Key predKey = pred->keys[pred->n - 1];
+            node->keys[idx] = predKey;
+            node->values[idx] = pred->values[pred->n - 1];
+            remove(node->children[idx], predKey);
         } else if (node->children[idx + 1]->n >= T) {
-            int succ = getSuccessor(node, idx);
-            node->keys[idx] = succ;
-            remove(node->children[idx + 1], succ);
+            NodeRef succ = getSuccessor(node, idx);
+            Key succKey = succ->keys[0];
+            node->keys[idx] = succKey;
+            node->values[idx] = succ->values[0];
+            remove(node->children[idx + 1], succKey);
         } else {
             merge(node, idx);
             remove(node->children[idx], key);
         }
     }
 
-    void remove(BTreeNode* node, int key) {
+    void remove(NodeRef node, const Key& key) {
         int idx = findKey(node, key);
         if (idx < node->n && node->keys[idx] == key) {
             if (node->leaf) removeFromLeaf(node, idx);
@@ -201,46 +270,417 @@ class BTree {
         }
     }
 
+    // Splits a level of `items` keys into nodes of ~target keys, with one key
+    // between neighbouring nodes going up to the parent level: node j holds
+    // count(j) keys starting at item start(j). The node count keeps every
+    // node within T - 1 .. 2T - 1 keys.
+    struct Spread {
+        size_t nodes, q, r;
+        size_t count(size_t j) const { return q + (j < r); }
+        size_t start(size_t j) const { return j * (q + 1) + min(j, r); }
+    };
+
+    static Spread spread(size_t items, size_t target) {
+        size_t lo = max<size_t>(1, (items + 2 * T) / (2 * T));   // ceil((items + 1) / 2T)
+        size_t hi = max(lo, (items + 1) / T);
+        size_t m = min(hi, max(lo, (items + 1 + target / 2) / (target + 1)));
+        size_t keys = items - (m - 1);
+        return {m, keys / m, keys % m};
+    }
+
+    size_t countNodes(NodeRef node) const {
+        size_t c = 1;
+        if (!node->leaf)
+            for (int i = 0; i <= node->n; i++) c += countNodes(node->children[i]);
+        return c;
+    }
+
+    void freeNodes(NodeRef node) {
+        if (!node->leaf)
+            for (int i = 0; i <= node->n; i++) freeNodes(node->children[i]);
+        node.release();
+    }
+
 public:
     BTree() { root = nullptr; }
+    ~BTree() { if (root != nullptr) freeNodes(root); }
+    BTree(const BTree&) = delete;
+    BTree& operator=(const BTree&) = delete;
 
-    void insert(int key) {
+    void insert(const Key& key, const Value& value = Value()) {
         if (root == nullptr) {
-            root = new BTreeNode(true);
+            root = NodeRef::make(true);
             root->keys[0] = key;
+            root->values[0] = value;
             root->n = 1;
         } else {
             if (root->n == 2 * T - 1) {
-                BTreeNode* newRoot = new BTreeNode(false);
+                NodeRef newRoot = NodeRef::make(false);
                 newRoot->children[0] = root;
                 splitChild(newRoot, 0, root);
-                int i = (newRoot->keys[0] < key) ? 1 : 0;
-                insertNonFull(newRoot->children[i], key);
                 root = newRoot;
-            } else {
-                insertNonFull(root, key);
             }
+            insertNonFull(root, key, value);
         }
     }
 
-    void remove(int key) {
+    void remove(const Key& key) {
         if (root == nullptr) { cout << "Tree is empty.\n"; return; }
         remove(root, key);
         if (root->n == 0) {
-            BTreeNode* temp = root;
+            NodeRef temp = root;
             root = root->leaf ? nullptr : root->children[0];
-            delete temp;
+            temp.release();
         }
     }
 
+    // copies the value into `value` if the key is present
+    bool find(const Key& key, Value& value) const {
+        NodeRef node = root;
+        while (node != nullptr) {
+            int idx = findKey(node, key);
+            if (idx < node->n && node->keys[idx] == key) {
+                value = node->values[idx];
+                return true;
+            }
+            node = node->leaf ? nullptr : node->children[idx];
+        }
+        return false;
+    }
+
+    bool contains(const Key& key) const {
+        Value value;
+        return find(key, value);
+    }
+
+    // Builds the tree bottom-up from n strictly increasing keys, into an
+    // empty tree: leaves are packed left to right with about fill * (2T - 1)
+    // keys each, the keys between them form the next level up, and so on to
+    // the root, one pass per level. With `parallel`, the nodes of a level are
+    // filled on several threads, which Ref::concurrent must allow.
+    void bulkLoad(const Key* keys, const Value* values, size_t n, double fill = 1.0, bool parallel = false) {
+        if (root != nullptr) throw logic_error("BTree::bulkLoad: tree is not empty");
+        if (parallel && !NodeRef::concurrent)
+            throw logic_error("BTree::bulkLoad: these node references cannot be used from several threads");
+        if (n == 0) return;
+        size_t target = min<size_t>(2 * T - 1, max<size_t>(T - 1, (size_t)(fill * (2 * T - 1))));
+        vector<NodeRef> below;   // the level built last
+        vector<size_t> items;    // positions of this level's keys; leaf level: all of 0..n-1
+        bool leaves = true;
+        size_t count = n;
+        while (true) {
+            Spread s = spread(count, target);
+            vector<NodeRef> level(s.nodes);
+            for (NodeRef& node : level) node = NodeRef::make(leaves);
+            vector<size_t> up(s.nodes - 1);
+            auto build = [&](size_t j) {
+                NodeRef node = level[j];
+                size_t first = s.start(j), k = s.count(j);
+                node->n = (int)k;
+                for (size_t i = 0; i < k; i++) {
+                    size_t p = leaves ? first + i : items[first + i];
+                    node->keys[i] = keys[p];
+                    node->values[i] = values[p];
+                }
+                if (!leaves)
+                    for (size_t i = 0; i <= k; i++) node->children[i] = below[first + i];
+                if (j + 1 < s.nodes) up[j] = leaves ? first + k : items[first + k];
+            };
+            if (parallel) parallelFor(0, s.nodes, 256, build);
+            else for (size_t j = 0; j < s.nodes; j++) build(j);
+            if (s.nodes == 1) {
+                root = level[0];
+                return;
+            }
+            below = move(level);
+            items = move(up);
+            count = items.size();
+            leaves = false;
+        }
+    }
+
+    size_t nodes() const { return root == nullptr ? 0 : countNodes(root); }
+
+    int height() const {
+        int h = 0;
+        for (NodeRef node = root; node != nullptr; node = node->leaf ? nullptr : node->children[0]) h++;
+        return h;
+    }
+
     void traverse() {
         if (root != nullptr) traverse(root);
         cout << endl;
     }
+
+    // for nodes that outlive the tree object (PagedBTree): the root can be
+    // read, adopted, and handed back so the destructor frees nothing
+    NodeRef rootNode() const { return root; }
+    void attach(NodeRef r) { root = r; }
+    void detach() { root = nullptr; }
+};
+
+// BTree whose nodes are 4 KB pages of a file, cached by a BufferPool of
+// `frames` pages; the tree code is the in-memory one, over PageRef. The root
+// page id is kept in the file header, so reopening the file reopens the tree.
+// Like PoolRef's shared pool, PageRef binds one file per node type, so only
+// one PagedBTree of a given <Key, Value> may be open at a time.
+template <class Key, class Value>
+class PagedBTree {
+public:
+    static const int T = degreeFor<Key, Value, PageRef>(BufferPool::PAGE);
+    using Tree = BTree<Key, Value, T, PageRef>;
+
+private:
+    static_assert(is_trivially_copyable<Key>::value && is_trivially_copyable<Value>::value,
+                  "keys and values are stored as raw bytes");
+
+    struct Meta {
+        uint32_t root;
+        uint32_t degree, keyBytes, valueBytes;   // checked when reopening
+    };
+
+    BufferPool pool;
+    Tree tree;
+
+    Meta& meta() { return *(Meta*)pool.userHeader(); }
+
+    void saveRoot() {
+        meta().root = tree.rootNode().index();
+        pool.markHeaderDirty();
+    }
+
+public:
+    PagedBTree(const string& path, size_t frames) : pool(path, frames) {
+        Tree::NodeRef::store = &pool;
+        Meta& m = meta();
+        Meta expected = {m.root, (uint32_t)T, (uint32_t)sizeof(Key), (uint32_t)sizeof(Value)};
+        if (pool.pageCount() == 1) {
+            m = {0, (uint32_t)T, (uint32_t)sizeof(Key), (uint32_t)sizeof(Value)};
+            pool.markHeaderDirty();
+        } else if (memcmp(&m, &expected, sizeof m) != 0) {
+            throw runtime_error("PagedBTree: file was written with another key / value layout");
+        }
+        tree.attach(typename Tree::NodeRef(m.root));
+    }
+
+    ~PagedBTree() {
+        tree.detach();
+        Tree::NodeRef::store = nullptr;
+    }
+
+    void insert(const Key& key, const Value& value = Value()) {
+        BufferPool::Operation op(pool, true);
+        tree.insert(key, value);
+        saveRoot();
+    }
+
+    void remove(const Key& key) {
+        BufferPool::Operation op(pool, true);
+        tree.remove(key);
+        saveRoot();
+    }
+
+    bool find(const Key& key, Value& value) {
+        BufferPool::Operation op(pool, false);
+        return tree.find(key, value);
+    }
+
+    bool contains(const Key& key) {
+        Value value;
+        return find(key, value);
+    }
+
+    void traverse() {
+        BufferPool::Operation op(pool, false);
+        tree.traverse();
+    }
+
+    int height() {
+        BufferPool::Operation op(pool, false);
+        return tree.height();
+    }
+
+    void flush() { pool.flush(); }
+    const BufferStats& stats() const { return pool.stats; }
+    void resetStats() { pool.stats = BufferStats(); }
+    uint32_t pages() const { return pool.pageCount(); }
+    bool directIo() const { return pool.directIo(); }
 };
 
-int main() {
-    BTree t;
+// Random inserts, lookups (half hits) and removing half the keys, for a
+// range of node sizes from one cache line to a few pages. ./4 bench [n]
+template <int T>
+void benchmarkOne(const vector<int>& keys, size_t target) {
+    int n = (int)keys.size();
+    size_t heapBefore = heapBytesInUse();
+    BTree<int, int, T> tree;
+
+    Timer ti;
+    for (int k : keys) tree.insert(k, k / 2);
+    double insertMs = ti.ms();
+    double bytesPerKey = (double)(heapBytesInUse() - heapBefore) / n;
+
+    Timer tl;
+    int64_t hits = 0, sum = 0;
+    for (int i = 0; i < n; i++) {
+        int value;
+        if (tree.find(keys[i] + (i & 1), value)) {
+            hits++;
+            sum += value;
+        }
+    }
+    double lookupMs = tl.ms();
+
+    Timer tr;
+    for (int i = 0; i < n / 2; i++) tree.remove(keys[i]);
+    double removeMs = tr.ms();
+    int64_t left = 0;
+    for (int i = 0; i < n; i++) left += tree.contains(keys[i]);
+
+    int64_t expectedSum = 0;
+    for (int i = 0; i < n; i += 2) expectedSum += keys[i] / 2;
+    bool ok = hits == (n + 1) / 2 && sum == expectedSum && left == n - n / 2;
+    printf("%5zu B: T=%-4d node %6zu B  height %d  %6.1f B/key  insert %6.2f  lookup %6.2f  remove %6.2f Mops  %s\n", target, T,
+           sizeof(typename BTree<int, int, T>::Node), tree.height(), bytesPerKey, mops(n, insertMs),
+           mops(n, lookupMs), mops(n / 2, removeMs), ok ? "ok" : "WRONG");
+}
+
+void benchmark(int n) {
+    vector<int> keys = randomKeys(n);
+    printf("BTree<int, int, T>, %d random keys, in-node search: %s\n", n, node_search::simdName());
+    // node budgets from two cache lines to four pages
+    benchmarkOne<degreeFor<int, int>(128)>(keys, 128);
+    benchmarkOne<degreeFor<int, int>(256)>(keys, 256);
+    benchmarkOne<degreeFor<int, int>(512)>(keys, 512);
+    benchmarkOne<degreeFor<int, int>(1024)>(keys, 1024);
+    benchmarkOne<degreeFor<int, int>(2048)>(keys, 2048);
+    benchmarkOne<degreeFor<int, int>(4096)>(keys, 4096);
+    benchmarkOne<degreeFor<int, int>(8192)>(keys, 8192);
+    benchmarkOne<degreeFor<int, int>(16384)>(keys, 16384);
+}
+
+// Loading n sorted keys: one insert per key vs bulkLoad at a few fill
+// factors, sequential and parallel; node utilization = keys / capacity.
+// ./4 bulk [n]
+void bulkBenchmark(int n) {
+    const int T = degreeFor<int, int>(4096);
+    vector<int> keys(n), values(n);
+    for (int i = 0; i < n; i++) {
+        keys[i] = 2 * i + 1;
+        values[i] = i;
+    }
+    printf("BTree<int, int, %d>, %d sorted keys, %d threads\n", T, n, numThreads());
+
+    auto report = [&](const char* name, BTree<int, int, T>& t, double ms) {
+        bool ok = true;
+        for (int i = 0; i < n && ok; i += 97) {
+            int v;
+            ok = t.find(keys[i], v) && v == i && !t.contains(keys[i] + 1);
+        }
+        double used = (double)n / ((double)t.nodes() * (2 * T - 1));
+        printf("%-24s %8.1f ms  %7.2f Mkeys/s  %6.2f GB/s  height %d  utilization %5.1f%%  %s\n", name, ms,
+               mops(n, ms), n * 8.0 / ms / 1e6, t.height(), 100 * used, ok ? "ok" : "WRONG");
+    };
+    {
+        BTree<int, int, T> t;
+        Timer timer;
+        for (int i = 0; i < n; i++) t.insert(keys[i], values[i]);
+        report("insert per key", t, timer.ms());
+    }
+    for (double fill : {1.0, 0.7}) {
+        for (bool parallel : {false, true}) {
+            BTree<int, int, T> t;
+            Timer timer;
+            t.bulkLoad(keys.data(), values.data(), n, fill, parallel);
+            double ms = timer.ms();
+            char name[64];
+            snprintf(name, sizeof name, "bulk, fill %.1f%s", fill, parallel ? ", parallel" : "");
+            report(name, t, ms);
+        }
+    }
+}
+
+// Builds a PagedBTree in `path` through a small buffer pool, looks keys up
+// and removes half, then reopens the file and checks what is left; prints
+// hit ratio and page reads / writes per operation for each phase.
+// ./4 paged index.pages [n] [pool_mb]
+void pagedBenchmark(const string& path, int n, double poolMb) {
+    vector<int> keys = randomKeys(n);
+    size_t frames = (size_t)(poolMb * 1048576 / BufferPool::PAGE);
+    unlink(path.c_str());
+    using Tree = PagedBTree<int, int>;
+
+    auto report = [&](const char* phase, Tree& t, int64_t ops, double ms, bool ok) {
+        const BufferStats& s = t.stats();
+        printf("%-8s %8.3f Mops  hit ratio %5.1f%%  %6.3f reads/op  %6.3f writes/op  %s\n", phase, mops(ops, ms),
+               100 * s.hitRatio(), (double)s.reads / ops, (double)s.writes / ops, ok ? "ok" : "WRONG");
+        t.resetStats();
+    };
+
+    {
+        Tree t(path, frames);
+        printf("paged BTree, T=%d, %d random keys, pool %zu frames of %zu B, %s I/O\n", Tree::T, n, frames,
+               BufferPool::PAGE, t.directIo() ? "direct" : "buffered");
+        Timer ti;
+        for (int k : keys) t.insert(k, k / 2);
+        t.flush();
+        report("insert", t, n, ti.ms(), true);
+
+        Timer tl;
+        int64_t hits = 0;
+        bool ok = true;
+        for (int i = 0; i < n; i++) {
+            int value;
+            bool found = t.find(keys[i] + (i & 1), value);
+            hits += found;
+            ok = ok && (!found || value == keys[i] / 2);
+        }
+        report("lookup", t, n, tl.ms(), ok && hits == (n + 1) / 2);
+
+        Timer tr;
+        for (int i = 0; i < n / 2; i++) t.remove(keys[i]);
+        t.flush();
+        report("remove", t, n / 2, tr.ms(), true);
+        printf("file: %u pages, %.1f MB, height %d\n", t.pages(), t.pages() * (double)BufferPool::PAGE / 1048576,
+               t.height());
+    }
+
+    Tree t(path, frames);   // reopened
+    Timer tc;
+    int64_t left = 0;
+    for (int i = 0; i < n; i++) left += t.contains(keys[i]);
+    report("reopen", t, n, tc.ms(), left == n - n / 2);
+
+    // one operation over every page, which may be many times the pool
+    vector<int> rest(keys.begin() + n / 2, keys.end());
+    sort(rest.begin(), rest.end());
+    string expected;
+    for (int k : rest) expected += to_string(k) + " ";
+    expected += "\n";
+    ostringstream out;
+    streambuf* console = cout.rdbuf(out.rdbuf());
+    Timer tt;
+    t.traverse();
+    double traverseMs = tt.ms();
+    cout.rdbuf(console);
+    report("traverse", t, (int64_t)rest.size(), traverseMs, out.str() == expected);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "bench") {
+        benchmark(argc > 2 ? atoi(argv[2]) : 4000000);
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "bulk") {
+        bulkBenchmark(argc > 2 ? atoi(argv[2]) : 10000000);
+        return 0;
+    }
+    if (argc > 2 && string(argv[1]) == "paged") {
+        pagedBenchmark(argv[2], argc > 3 ? atoi(argv[3]) : 1000000, argc > 4 ? atof(argv[4]) : 4);
+        return 0;
+    }
+
+    BTree<int, int, 3> t;
     t.insert(10); t.insert(20); t.insert(5);
     t.insert(6);  t.insert(12); t.insert(30);
     t.insert(7);  t.insert(17);
@@ -257,4 +697,4 @@ int main() {
     t.traverse();
 
     return 0;
-}
\ No newline at end of file
+}
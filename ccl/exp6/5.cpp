@@ -1,14 +1,32 @@
 #include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <iterator>
+#include <set>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include "bench_util.h"
+#include "fork_join.h"
+#include "node_search.h"
 using namespace std;
 
-const int ORDER = 4;
-
+// A node splits when it reaches ORDER keys, so it holds at most ORDER - 1.
+// `next` sits next to the keys, so a leaf walk only touches its first
+// n * 4 + 16 bytes; keys has SIMD slack for node_search.
+template <int ORDER>
 struct Node {
     bool leaf;
     int n;
-    int keys[ORDER];
-    Node* children[ORDER + 1];
     Node* next;
+    int keys[node_search::keySlots(ORDER)];
+    Node* children[ORDER + 1];
 
     Node(bool isLeaf) {
         leaf = isLeaf;
@@ -19,7 +37,10 @@ struct Node {
     }
 };
 
+template <int ORDER = 4>
 class BPlusTree {
+    using Node = ::Node<ORDER>;
+
     Node* root;
 
     // Returns promoted key and new node if a split happened, else {-1, nullptr}
@@ -81,8 +102,94 @@ class BPlusTree {
         }
     }
 
+    // `count` entries into ~target per node, each node within [low, high]
+    // (one node if count < low): node j gets count(j) entries from start(j)
+    struct Spread {
+        size_t nodes, q, r;
+        size_t count(size_t j) const { return q + (j < r); }
+        size_t start(size_t j) const { return j * q + min(j, r); }
+    };
+
+    static Spread spread(size_t count, size_t target, size_t low, size_t high) {
+        size_t lo = max<size_t>(1, (count + high - 1) / high);
+        size_t hi = max(lo, count / low);
+        size_t m = min(hi, max(lo, (count + target / 2) / target));
+        return {m, count / m, count % m};
+    }
+
+    size_t countNodes(Node* node) const {
+        size_t c = 1;
+        if (!node->leaf)
+            for (int i = 0; i <= node->n; i++) c += countNodes(node->children[i]);
+        return c;
+    }
+
+    void freeNodes(Node* node) {
+        if (!node->leaf)
+            for (int i = 0; i <= node->n; i++) freeNodes(node->children[i]);
+        delete node;
+    }
+
+    // Pulls a leaf's header and keys into cache ahead of the walk reaching it
+    // (the walk itself would stall on every leaf: leaves are far apart).
+    static void prefetchLeaf(const Node* leaf) {
+        if (leaf == nullptr) return;
+        const char* p = (const char*)leaf;
+        for (size_t off = 0; off < offsetof(Node, children); off += 64)
+            __builtin_prefetch(p + off);
+    }
+
+    // Leaf and index of the first key >= key (nullptr, 0 if none). Separators
+    // equal to key send the descent left, so the first of several equal keys
+    // is found; the answer may then be the next leaf's first key.
+    pair<const Node*, int> lowerBoundPos(int key) const {
+        const Node* node = root;
+        while (!node->leaf)
+            node = node->children[node_search::lowerBound(node->keys, node->n, key)];
+        int i = node_search::lowerBound(node->keys, node->n, key);
+        while (node != nullptr && i == node->n) {
+            node = node->next;
+            i = 0;
+        }
+        return {node, i};
+    }
+
 public:
+    // Forward iterator over the keys in order, along the leaf chain.
+    class const_iterator {
+        friend class BPlusTree;
+        const Node* leaf = nullptr;
+        int index = 0;
+        const_iterator(const Node* l, int i) : leaf(l), index(i) {}
+
+    public:
+        using iterator_category = forward_iterator_tag;
+        using value_type = int;
+        using difference_type = ptrdiff_t;
+        using reference = const int&;
+        using pointer = const int*;
+
+        const_iterator() = default;
+        reference operator*() const { return leaf->keys[index]; }
+        pointer operator->() const { return &leaf->keys[index]; }
+        const_iterator& operator++() {
+            if (++index == leaf->n) {
+                leaf = leaf->next;
+                index = 0;
+                if (leaf != nullptr) prefetchLeaf(leaf->next);
+            }
+            return *this;
+        }
+        const_iterator operator++(int) { const_iterator old = *this; ++*this; return old; }
+        bool operator==(const const_iterator& o) const { return leaf == o.leaf && index == o.index; }
+        bool operator!=(const const_iterator& o) const { return !(*this == o); }
+    };
+    using iterator = const_iterator;
+
     BPlusTree() { root = new Node(true); }
+    ~BPlusTree() { freeNodes(root); }
+    BPlusTree(const BPlusTree&) = delete;
+    BPlusTree& operator=(const BPlusTree&) = delete;
 
     void insert(int key) {
         auto [promKey, newNode] = insertHelper(root, key);
@@ -96,6 +203,113 @@ public:
         }
     }
 
+    // Builds the tree bottom-up from n sorted keys, into an empty tree:
+    // leaves are packed left to right with about fill * (ORDER - 1) keys and
+    // chained, then each internal level is built over the one below in one
+    // pass (separator = first key of the right subtree), up to the root.
+    // With `parallel`, the nodes of a level are filled on several threads.
+    void bulkLoad(const int* keys, size_t n, double fill = 1.0, bool parallel = false) {
+        if (root->n != 0 || !root->leaf) throw logic_error("BPlusTree::bulkLoad: tree is not empty");
+        if (n == 0) return;
+        // the smallest nodes a split leaves behind set the minimum
+        size_t leafMax = ORDER - 1, leafMin = ORDER / 2;
+        size_t fanMax = ORDER, fanMin = (ORDER + 1) / 2;
+        auto target = [&](size_t lo, size_t hi) { return min(hi, max(lo, (size_t)(fill * hi))); };
+
+        Spread s = spread(n, target(leafMin, leafMax), leafMin, leafMax);
+        vector<Node*> level(s.nodes);
+        vector<int> lowKeys(s.nodes);   // smallest key under each node
+        delete root;
+        for (Node*& node : level) node = new Node(true);
+        auto buildLeaf = [&](size_t j) {
+            Node* leaf = level[j];
+            size_t first = s.start(j);
+            leaf->n = (int)s.count(j);
+            copy(keys + first, keys + first + leaf->n, leaf->keys);
+            leaf->next = j + 1 < s.nodes ? level[j + 1] : nullptr;
+            lowKeys[j] = keys[first];
+        };
+        if (parallel) parallelFor(0, s.nodes, 256, buildLeaf);
+        else for (size_t j = 0; j < s.nodes; j++) buildLeaf(j);
+
+        while (level.size() > 1) {
+            Spread p = spread(level.size(), target(fanMin, fanMax), fanMin, fanMax);
+            vector<Node*> up(p.nodes);
+            vector<int> upLow(p.nodes);
+            for (Node*& node : up) node = new Node(false);
+            auto buildInner = [&](size_t j) {
+                Node* node = up[j];
+                size_t first = p.start(j), fan = p.count(j);
+                node->n = (int)fan - 1;
+                for (size_t i = 0; i < fan; i++) {
+                    node->children[i] = level[first + i];
+                    if (i > 0) node->keys[i - 1] = lowKeys[first + i];
+                }
+                upLow[j] = lowKeys[first];
+            };
+            if (parallel) parallelFor(0, p.nodes, 256, buildInner);
+            else for (size_t j = 0; j < p.nodes; j++) buildInner(j);
+            level = move(up);
+            lowKeys = move(upLow);
+        }
+        root = level[0];
+    }
+
+    size_t nodes() const { return countNodes(root); }
+
+    int height() const {
+        int h = 1;
+        for (Node* node = root; !node->leaf; node = node->children[0]) h++;
+        return h;
+    }
+
+    const_iterator begin() const {
+        const Node* node = root;
+        while (!node->leaf) node = node->children[0];
+        if (node->n == 0) return end();
+        prefetchLeaf(node->next);
+        return {node, 0};
+    }
+    const_iterator end() const { return {}; }
+
+    // first key >= key, end() if none
+    const_iterator lower_bound(int key) const {
+        auto [leaf, i] = lowerBoundPos(key);
+        if (leaf != nullptr) prefetchLeaf(leaf->next);
+        return {leaf, i};
+    }
+
+    const_iterator find(int key) const {
+        auto [leaf, i] = lowerBoundPos(key);
+        return leaf != nullptr && leaf->keys[i] == key ? const_iterator(leaf, i) : end();
+    }
+    bool contains(int key) const { return find(key) != end(); }
+
+    // Keys in [lo, hi], handed to fn(const int* keys, int count) one leaf's
+    // contiguous run at a time, so the consumer can loop over plain arrays.
+    // One descent, then the leaf chain, with the next leaf prefetched.
+    template <class Fn>
+    void scanSpans(int lo, int hi, Fn&& fn) const {
+        if (lo > hi) return;
+        auto [leaf, i] = lowerBoundPos(lo);
+        while (leaf != nullptr) {
+            prefetchLeaf(leaf->next);
+            int stop = leaf->keys[leaf->n - 1] <= hi ? leaf->n : node_search::upperBound(leaf->keys, leaf->n, hi);
+            if (stop > i) fn(leaf->keys + i, stop - i);
+            if (stop < leaf->n) return;
+            leaf = leaf->next;
+            i = 0;
+        }
+    }
+
+    // fn(key) for every key in [lo, hi], in order
+    template <class Fn>
+    void scan(int lo, int hi, Fn&& fn) const {
+        scanSpans(lo, hi, [&](const int* keys, int count) {
+            for (int i = 0; i < count; i++) fn(keys[i]);
+        });
+    }
+
     // Traverse only through leaf nodes (all data is in leaves, linked together)
     void traverse() {
         Node* cur = root;
@@ -110,8 +324,537 @@ public:
     }
 };
 
-int main() {
-    BPlusTree t;
+// ---- concurrent B+ tree: optimistic lock coupling ----
+//
+// Every node carries a version word: odd while a writer holds the node,
+// bumped by 2 per write. A reader never writes shared memory. It records a
+// node's version, reads the node, and re-checks the version before using
+// what it read; if the version moved, it restarts from the root. Going
+// down, a child is entered only after the parent's version is checked
+// again, so a child that split in between is never trusted.
+//
+// Writers descend the same way and lock only the nodes they change: the leaf,
+// or the full node and its parent when splitting. Full nodes are split on
+// the way down (then the insert restarts), so a split never has to go up
+// more than one level. Keys are not removed and nodes are never freed while
+// the tree is shared, so a pointer read optimistically always points at a
+// node.
+//
+// Shared fields are read and written with relaxed atomics (plain moves on
+// x86), ordered by the acquire / release on the version, as in a seqlock.
+template <int ORDER>
+struct OlcNode {
+    uint64_t version = 0;
+    bool leaf;   // fixed at creation
+    int n = 0;
+    OlcNode* next = nullptr;   // leaves: right sibling
+    int keys[ORDER];
+    union {
+        OlcNode* children[ORDER + 1];
+        int values[ORDER];
+    };
+
+    OlcNode(bool isLeaf) : leaf(isLeaf) {
+        for (int i = 0; i <= ORDER; i++) children[i] = nullptr;
+    }
+
+    template <class T>
+    static T load(const T& x) { return __atomic_load_n(&x, __ATOMIC_RELAXED); }
+    template <class T>
+    static void store(T& x, T v) { __atomic_store_n(&x, v, __ATOMIC_RELAXED); }
+
+    // version once no writer holds the node
+    uint64_t readLock() const {
+        for (int spin = 0;; spin++) {
+            uint64_t v = __atomic_load_n(&version, __ATOMIC_ACQUIRE);
+            if ((v & 1) == 0) return v;
+            if (spin >= 64) this_thread::yield();
+        }
+    }
+    // true if nothing was written since readLock returned v
+    bool validate(uint64_t v) const {
+        atomic_thread_fence(memory_order_acquire);
+        return __atomic_load_n(&version, __ATOMIC_RELAXED) == v;
+    }
+    // takes the write lock if the node is still at version v
+    bool upgrade(uint64_t v) {
+        if (!__atomic_compare_exchange_n(&version, &v, v + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return false;
+        atomic_thread_fence(memory_order_release);
+        return true;
+    }
+    void unlock() { __atomic_fetch_add(&version, 1, __ATOMIC_RELEASE); }
+
+    // Branch-free binary searches (as in node_search), with relaxed loads:
+    // first index with keys[i] > key (child to follow), first with >= key.
+    // A torn read only gives a wrong index, which validation then rejects.
+    template <bool Upper>
+    int search(int key) const {
+        int base = 0, len = min(load(n), ORDER - 1);
+        while (len > 0) {
+            int half = len / 2;
+            int k = load(keys[base + half]);
+            bool right = Upper ? k <= key : k < key;
+            base = right ? base + half + 1 : base;
+            len = right ? len - half - 1 : half;
+        }
+        return base;
+    }
+    int upperBound(int key) const { return search<true>(key); }
+    int lowerBound(int key) const { return search<false>(key); }
+};
+
+// Thread-safe int -> int map; a node holds at most ORDER - 1 keys, as in
+// BPlusTree. insert / lookup / scan may run from any number of threads.
+template <int ORDER = 64>
+class ConcurrentBPlusTree {
+    using Node = OlcNode<ORDER>;
+
+    Node* root;
+
+    Node* loadRoot() const { return __atomic_load_n(&root, __ATOMIC_ACQUIRE); }
+
+    static void backoff(int attempt) {
+        if (attempt > 2) this_thread::yield();
+    }
+
+    // Splits a full, write-locked node into itself and a new right node;
+    // the separator to insert into the parent goes to `sep`.
+    static Node* split(Node* node, int& sep) {
+        Node* right = new Node(node->leaf);
+        int n = node->n;
+        if (node->leaf) {
+            int mid = n / 2;
+            right->n = n - mid;
+            for (int j = 0; j < right->n; j++) {
+                right->keys[j] = node->keys[mid + j];
+                right->values[j] = node->values[mid + j];
+            }
+            right->next = node->next;
+            sep = right->keys[0];
+            Node::store(node->next, right);
+            Node::store(node->n, mid);
+        } else {
+            int mid = n / 2;
+            sep = node->keys[mid];
+            right->n = n - mid - 1;
+            for (int j = 0; j < right->n; j++) right->keys[j] = node->keys[mid + 1 + j];
+            for (int j = 0; j <= right->n; j++) right->children[j] = node->children[mid + 1 + j];
+            Node::store(node->n, mid);
+        }
+        return right;
+    }
+
+    // puts (sep, right) into a write-locked, non-full inner node
+    static void insertChild(Node* node, int sep, Node* right) {
+        int n = node->n;
+        int i = node->upperBound(sep);
+        for (int j = n; j > i; j--) {
+            Node::store(node->keys[j], node->keys[j - 1]);
+            Node::store(node->children[j + 1], node->children[j]);
+        }
+        Node::store(node->keys[i], sep);
+        Node::store(node->children[i + 1], right);
+        Node::store(node->n, n + 1);
+    }
+
+    void freeNodes(Node* node) {
+        if (!node->leaf)
+            for (int i = 0; i <= node->n; i++) freeNodes(node->children[i]);
+        delete node;
+    }
+
+    // Leaf that holds key's position and its version, validated against the
+    // parent after it was entered; nullptr to restart.
+    const Node* findLeaf(int key, uint64_t& v) const {
+        const Node* node = loadRoot();
+        v = node->readLock();
+        if (node != loadRoot()) return nullptr;
+        while (!node->leaf) {
+            const Node* child = Node::load(node->children[node->upperBound(key)]);
+            if (!node->validate(v)) return nullptr;
+            uint64_t vc = child->readLock();
+            if (!node->validate(v)) return nullptr;
+            node = child;
+            v = vc;
+        }
+        return node;
+    }
+
+public:
+    ConcurrentBPlusTree() { root = new Node(true); }
+    ~ConcurrentBPlusTree() { freeNodes(root); }
+    ConcurrentBPlusTree(const ConcurrentBPlusTree&) = delete;
+    ConcurrentBPlusTree& operator=(const ConcurrentBPlusTree&) = delete;
+
+    // Inserts key, or overwrites its value; true if the key is new.
+    bool insert(int key, int value) {
+        for (int attempt = 0;; attempt++) {
+            backoff(attempt);
+            Node* node = loadRoot();
+            uint64_t v = node->readLock();
+            if (node != loadRoot()) continue;
+            Node* parent = nullptr;
+            uint64_t vp = 0;
+            bool restart = false;
+            while (!restart) {
+                if (Node::load(node->n) == ORDER - 1) {
+                    // full: split it under its parent's lock, then start over
+                    if (parent != nullptr && !parent->upgrade(vp)) break;
+                    if (!node->upgrade(v)) {
+                        if (parent != nullptr) parent->unlock();
+                        break;
+                    }
+                    if (parent == nullptr && node != loadRoot()) {
+                        node->unlock();
+                        break;
+                    }
+                    int sep;
+                    Node* right = split(node, sep);
+                    if (parent != nullptr) {
+                        insertChild(parent, sep, right);
+                    } else {
+                        Node* top = new Node(false);
+                        top->n = 1;
+                        top->keys[0] = sep;
+                        top->children[0] = node;
+                        top->children[1] = right;
+                        __atomic_store_n(&root, top, __ATOMIC_RELEASE);
+                    }
+                    node->unlock();
+                    if (parent != nullptr) parent->unlock();
+                    break;
+                }
+                if (node->leaf) {
+                    if (!node->upgrade(v)) break;
+                    int n = node->n;
+                    int i = node->lowerBound(key);
+                    bool fresh = i == n || node->keys[i] != key;
+                    if (fresh) {
+                        for (int j = n; j > i; j--) {
+                            Node::store(node->keys[j], node->keys[j - 1]);
+                            Node::store(node->values[j], node->values[j - 1]);
+                        }
+                        Node::store(node->keys[i], key);
+                        Node::store(node->n, n + 1);
+                    }
+                    Node::store(node->values[i], value);
+                    node->unlock();
+                    return fresh;
+                }
+                Node* child = Node::load(node->children[node->upperBound(key)]);
+                if (!node->validate(v)) break;
+                uint64_t vc = child->readLock();
+                restart = !node->validate(v);
+                parent = node;
+                vp = v;
+                node = child;
+                v = vc;
+            }
+        }
+    }
+
+    bool lookup(int key, int& value) const {
+        for (int attempt = 0;; attempt++) {
+            backoff(attempt);
+            uint64_t v;
+            const Node* leaf = findLeaf(key, v);
+            if (leaf == nullptr) continue;
+            int i = leaf->lowerBound(key);
+            bool found = i < Node::load(leaf->n) && Node::load(leaf->keys[i]) == key;
+            int val = Node::load(leaf->values[i]);
+            if (!leaf->validate(v)) continue;
+            if (found) value = val;
+            return found;
+        }
+    }
+
+    // fn(key, value) for every key in [lo, hi], in order. Each leaf is copied
+    // out and validated before fn sees it; then the scan follows the next
+    // pointer read in that same snapshot, so a concurrent split neither hides
+    // keys nor shows them twice. After a conflict it resumes past the last
+    // key it reported.
+    template <class Fn>
+    void scan(int lo, int hi, Fn&& fn) const {
+        int keys[ORDER], values[ORDER];
+        for (int attempt = 0; lo <= hi; attempt++) {
+            backoff(attempt);
+            uint64_t v;
+            const Node* leaf = findLeaf(lo, v);
+            if (leaf == nullptr) continue;
+            int i = leaf->lowerBound(lo);
+            while (true) {
+                int n = min(Node::load(leaf->n), ORDER - 1), count = 0;
+                for (; i < n; i++, count++) {
+                    keys[count] = Node::load(leaf->keys[i]);
+                    values[count] = Node::load(leaf->values[i]);
+                }
+                const Node* next = Node::load(leaf->next);
+                if (!leaf->validate(v)) break;
+                for (int j = 0; j < count; j++) {
+                    if (keys[j] > hi) return;
+                    fn(keys[j], values[j]);
+                }
+                if (count > 0) {
+                    if (keys[count - 1] == hi) return;
+                    lo = keys[count - 1] + 1;
+                }
+                if (next == nullptr) return;
+                v = next->readLock();
+                leaf = next;
+                i = 0;
+            }
+        }
+    }
+
+    // the following are for quiescent trees only
+    size_t size() const {
+        const Node* node = root;
+        while (!node->leaf) node = node->children[0];
+        size_t count = 0;
+        for (; node != nullptr; node = node->next) count += node->n;
+        return count;
+    }
+
+    int height() const {
+        int h = 1;
+        for (const Node* node = root; !node->leaf; node = node->children[0]) h++;
+        return h;
+    }
+};
+
+// Loading n sorted keys: one insert per key vs bulkLoad at a few fill
+// factors, sequential and parallel; leaf utilization = keys / leaf capacity.
+// ./5 bulk [n]
+void bulkBenchmark(int n) {
+    const int ORDER = 256;
+    vector<int> keys(n);
+    for (int i = 0; i < n; i++) keys[i] = 2 * i + 1;
+    printf("BPlusTree<%d>, %d sorted keys, %d threads\n", ORDER, n, numThreads());
+
+    auto report = [&](const char* name, BPlusTree<ORDER>& t, double ms) {
+        size_t nodes = t.nodes();
+        printf("%-24s %8.1f ms  %7.2f Mkeys/s  %6.2f GB/s  height %d  %zu nodes  utilization %5.1f%%\n", name, ms,
+               mops(n, ms), n * 4.0 / ms / 1e6, t.height(), nodes, 100.0 * n / ((double)nodes * (ORDER - 1)));
+    };
+    {
+        BPlusTree<ORDER> t;
+        Timer timer;
+        for (int k : keys) t.insert(k);
+        report("insert per key", t, timer.ms());
+    }
+    for (double fill : {1.0, 0.7}) {
+        for (bool parallel : {false, true}) {
+            BPlusTree<ORDER> t;
+            Timer timer;
+            t.bulkLoad(keys.data(), n, fill, parallel);
+            double ms = timer.ms();
+            char name[64];
+            snprintf(name, sizeof name, "bulk, fill %.1f%s", fill, parallel ? ", parallel" : "");
+            report(name, t, ms);
+        }
+    }
+}
+
+// Scan throughput over n keys, in Mkeys/s: full scans with the iterator,
+// scan() and scanSpans(), then short range scans from random starts, on a
+// bulk-loaded tree (leaves in address order) and on one built by random
+// inserts (leaves scattered), against std::set and a sorted vector.
+// ./5 scan [n]
+void scanBenchmark(int n) {
+    const int ORDER = 256;
+    const int RANGES = 200000, RANGE_KEYS = 100;
+    vector<int> keys = randomKeys(n);
+    vector<int> sorted = keys;
+    sort(sorted.begin(), sorted.end());
+    int64_t expected = 0;
+    for (int k : sorted) expected += k;
+
+    BPlusTree<ORDER> bulk, inserted;
+    bulk.bulkLoad(sorted.data(), n);
+    for (int k : keys) inserted.insert(k);
+    set<int> ordered(sorted.begin(), sorted.end());
+
+    vector<int> starts(RANGES);
+    for (int i = 0; i < RANGES; i++) starts[i] = keys[i % n];
+    int64_t rangeExpected = 0;
+    for (int lo : starts) {
+        auto it = std::lower_bound(sorted.begin(), sorted.end(), lo);
+        for (auto e = std::upper_bound(it, sorted.end(), lo + 2 * (RANGE_KEYS - 1)); it != e; ++it) rangeExpected += *it;
+    }
+
+    printf("BPlusTree<%d> scans, %d keys; %d ranges of %d keys; Mkeys/s\n", ORDER, n, RANGES, RANGE_KEYS);
+    auto report = [&](const char* name, double ms, int64_t sum, int64_t want, int64_t scanned) {
+        printf("%-28s %9.1f  %s\n", name, mops(scanned, ms), sum == want ? "ok" : "MISMATCH");
+    };
+    auto full = [&](const char* name, auto&& sumAll) {
+        Timer timer;
+        int64_t sum = sumAll();
+        report(name, timer.ms(), sum, expected, n);
+    };
+    auto ranges = [&](const char* name, auto&& sumRange) {
+        Timer timer;
+        int64_t sum = 0;
+        for (int lo : starts) sum += sumRange(lo, lo + 2 * (RANGE_KEYS - 1));
+        report(name, timer.ms(), sum, rangeExpected, (int64_t)RANGES * RANGE_KEYS);
+    };
+
+    full("sorted vector", [&] { int64_t s = 0; for (int k : sorted) s += k; return s; });
+    full("std::set", [&] { int64_t s = 0; for (int k : ordered) s += k; return s; });
+    for (auto* t : {&bulk, &inserted}) {
+        const char* built = t == &bulk ? "bulk" : "inserted";
+        char name[64];
+        snprintf(name, sizeof name, "%s, iterator", built);
+        full(name, [&] { int64_t s = 0; for (int k : *t) s += k; return s; });
+        snprintf(name, sizeof name, "%s, scan", built);
+        full(name, [&] { int64_t s = 0; t->scan(INT32_MIN, INT32_MAX, [&](int k) { s += k; }); return s; });
+        snprintf(name, sizeof name, "%s, scanSpans", built);
+        full(name, [&] {
+            int64_t s = 0;
+            t->scanSpans(INT32_MIN, INT32_MAX, [&](const int* k, int count) {
+                for (int i = 0; i < count; i++) s += k[i];
+            });
+            return s;
+        });
+    }
+    ranges("ranges, std::set", [&](int lo, int hi) {
+        int64_t s = 0;
+        for (auto it = ordered.lower_bound(lo); it != ordered.end() && *it <= hi; ++it) s += *it;
+        return s;
+    });
+    for (auto* t : {&bulk, &inserted}) {
+        char name[64];
+        snprintf(name, sizeof name, "ranges, %s, scanSpans", t == &bulk ? "bulk" : "inserted");
+        ranges(name, [&](int lo, int hi) {
+            int64_t s = 0;
+            t->scanSpans(lo, hi, [&](const int* k, int count) {
+                for (int i = 0; i < count; i++) s += k[i];
+            });
+            return s;
+        });
+    }
+}
+
+// The single-threaded BPlusTree behind one global mutex, with the
+// ConcurrentBPlusTree interface (the value of a key is the key itself).
+struct MutexBPlusTree {
+    BPlusTree<64> t;
+    mutable mutex m;
+
+    bool insert(int key, int) {
+        lock_guard<mutex> lock(m);
+        t.insert(key);
+        return true;
+    }
+    bool lookup(int key, int& value) const {
+        lock_guard<mutex> lock(m);
+        value = key;
+        return t.contains(key);
+    }
+    template <class Fn>
+    void scan(int lo, int hi, Fn&& fn) const {
+        lock_guard<mutex> lock(m);
+        t.scan(lo, hi, [&](int k) { fn(k, k); });
+    }
+    size_t size() const { return distance(t.begin(), t.end()); }
+};
+
+// YCSB-style mixes on n preloaded odd keys, chosen uniformly:
+//   read-heavy  95% lookup,  5% insert
+//   write-heavy 50% lookup, 50% insert
+//   scan        95% scan of 1-100 keys, 5% insert
+// Inserted keys are fresh even keys, so every lookup must hit and the final
+// size is known. `ops` operations per run are split over 1-16 threads.
+// ./5 ycsb [n] [ops]
+void ycsbBenchmark(int n, int ops) {
+    struct Mix { const char* name; int readPct, insertPct; };
+    const Mix mixes[] = {{"read-heavy", 95, 5}, {"write-heavy", 50, 50}, {"scan", 0, 5}};
+    const int threadCounts[] = {1, 2, 4, 8, 16};
+    vector<int> keys = randomKeys(n);
+
+    printf("YCSB-style mixes, %d keys, %d ops per run, %d hardware threads, Mops/s\n", n, ops,
+           (int)thread::hardware_concurrency());
+    printf("%-12s %-6s", "workload", "tree");
+    for (int t : threadCounts) printf("  %3d thr", t);
+    printf("\n");
+
+    auto runAll = [&](const char* treeName, auto& tree) {
+        for (int k : keys) tree.insert(k, k);
+        atomic<int64_t> inserted(0), misses(0);
+        uint32_t freshBase = 0;
+        for (const Mix& mix : mixes) {
+            printf("%-12s %-6s", mix.name, treeName);
+            for (int threads : threadCounts) {
+                int perThread = ops / threads;
+                atomic<int> ready(0);
+                atomic<bool> go(false);
+                vector<thread> workers;
+                for (int t = 0; t < threads; t++) {
+                    workers.emplace_back([&, t] {
+                        mt19937_64 rng(freshBase + t);
+                        // fresh keys: an odd multiplier permutes [0, 2^30)
+                        uint32_t fresh = freshBase + (uint32_t)t * perThread;
+                        int64_t myInserts = 0, myMisses = 0, sink = 0;
+                        ready++;
+                        while (!go) this_thread::yield();
+                        for (int i = 0; i < perThread; i++) {
+                            int dice = (int)(rng() % 100);
+                            int key = keys[rng() % n];
+                            if (dice < mix.insertPct) {
+                                int k = 2 * (int)((fresh++ * 0x9E3779B1u) & ((1u << 30) - 1));
+                                tree.insert(k, k);
+                                myInserts++;
+                            } else if (dice < mix.insertPct + mix.readPct) {
+                                int value;
+                                myMisses += !tree.lookup(key, value) || value != key;
+                            } else {
+                                int len = 1 + (int)(rng() % 100);
+                                tree.scan(key, key + 2 * (len - 1), [&](int k, int) { sink += k; });
+                            }
+                        }
+                        inserted += myInserts;
+                        misses += myMisses + (sink < 0);
+                    });
+                }
+                while (ready < threads) this_thread::yield();
+                Timer timer;
+                go = true;
+                for (thread& w : workers) w.join();
+                printf("  %7.2f", mops((int64_t)perThread * threads, timer.ms()));
+                fflush(stdout);
+                freshBase += ops;
+            }
+            printf("\n");
+        }
+        bool ok = misses == 0 && tree.size() == (size_t)n + inserted;
+        printf("%-12s %-6s  %zu keys after the runs, lookup misses %lld  %s\n", "check", treeName, tree.size(),
+               (long long)misses.load(), ok ? "ok" : "WRONG");
+    };
+    {
+        ConcurrentBPlusTree<64> tree;
+        runAll("OLC", tree);
+    }
+    {
+        MutexBPlusTree tree;
+        runAll("mutex", tree);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "bulk") {
+        bulkBenchmark(argc > 2 ? atoi(argv[2]) : 10000000);
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "scan") {
+        scanBenchmark(argc > 2 ? atoi(argv[2]) : 10000000);
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "ycsb") {
+        ycsbBenchmark(argc > 2 ? atoi(argv[2]) : 1000000, argc > 3 ? atoi(argv[3]) : 1000000);
+        return 0;
+    }
+
+    BPlusTree<> t;
     t.insert(10); t.insert(20); t.insert(5);
     t.insert(6);  t.insert(12); t.insert(30);
     t.insert(7);  t.insert(17);
@@ -120,4 +863,4 @@ int main() {
     t.traverse();
 
     return 0;
-}
\ No newline at end of file
+}
@@ -1,57 +1,84 @@
 #include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include "node_pool.h"
+#include "bench_util.h"
+#include "fork_join.h"
 using namespace std;
 
-struct Node {
+// Ref = PoolRef (32-bit pool index) or HeapRef (new / delete)
+template <template <class> class Ref>
+struct BasicNode {
     int data, height;
-    Node* left;
-    Node* right;
-    Node(int val) {
+    int size;   // nodes in this subtree, for rank / select
+    Ref<BasicNode> left;
+    Ref<BasicNode> right;
+    BasicNode(int val) {
         data = val;
         height = 1;
+        size = 1;
         left = right = nullptr;
     }
 };
 
-int height(Node* node) {
+using Node = BasicNode<PoolRef>;
+using NodeRef = PoolRef<Node>;
+
+template <class NodeRef>
+int height(NodeRef node) {
     return node == nullptr ? 0 : node->height;
 }
 
-int getBalance(Node* node) {
+template <class NodeRef>
+int subtreeSize(NodeRef node) {
+    return node == nullptr ? 0 : node->size;
+}
+
+template <class NodeRef>
+int getBalance(NodeRef node) {
     return node == nullptr ? 0 : height(node->left) - height(node->right);
 }
 
-void updateHeight(Node* node) {
+template <class NodeRef>
+void updateNode(NodeRef node) {
     node->height = 1 + max(height(node->left), height(node->right));
+    node->size = 1 + subtreeSize(node->left) + subtreeSize(node->right);
 }
 
-Node* rightRotate(Node* y) {
-    Node* x  = y->left;
-    Node* T2 = x->right;
+template <class NodeRef>
+NodeRef rightRotate(NodeRef y) {
+    NodeRef x  = y->left;
+    NodeRef T2 = x->right;
     x->right = y;
     y->left  = T2;
-    updateHeight(y);
-    updateHeight(x);
+    updateNode(y);
+    updateNode(x);
     return x;
 }
 
-Node* leftRotate(Node* x) {
-    Node* y  = x->right;
-    Node* T2 = y->left;
+template <class NodeRef>
+NodeRef leftRotate(NodeRef x) {
+    NodeRef y  = x->right;
+    NodeRef T2 = y->left;
     y->left  = x;
     x->right = T2;
-    updateHeight(x);
-    updateHeight(y);
+    updateNode(x);
+    updateNode(y);
     return y;
 }
 
-Node* insert(Node* root, int key) {
-    if (root == nullptr) return new Node(key);
+template <class NodeRef>
+NodeRef insert(NodeRef root, int key) {
+    if (root == nullptr) return NodeRef::make(key);
 
     if (key < root->data)      root->left  = insert(root->left, key);
     else if (key > root->data) root->right = insert(root->right, key);
     else return root;
 
-    updateHeight(root);
+    updateNode(root);
     int balance = getBalance(root);
 
     if (balance > 1 && key < root->left->data)       return rightRotate(root);           // LL
@@ -68,22 +95,430 @@ Node* insert(Node* root, int key) {
     return root;
 }
 
-bool isHeightBalanced(Node* root) {
+template <class NodeRef>
+bool search(NodeRef root, int key) {
+    while (root != nullptr && root->data != key)
+        root = key < root->data ? root->left : root->right;
+    return root != nullptr;
+}
+
+// ---- order statistics, O(log n) through the subtree sizes ----
+
+// number of keys < key (inclusive: <= key)
+template <class NodeRef>
+int rankOf(NodeRef root, int key, bool inclusive = false) {
+    int r = 0;
+    while (root != nullptr) {
+        if (key < root->data || (key == root->data && !inclusive)) {
+            root = root->left;
+        } else {
+            r += subtreeSize(root->left) + 1;
+            root = root->right;
+        }
+    }
+    return r;
+}
+
+// node holding the k-th smallest key (0-based), nullptr if k is out of range
+template <class NodeRef>
+NodeRef selectKth(NodeRef root, int k) {
+    while (root != nullptr) {
+        int left = subtreeSize(root->left);
+        if (k < left) {
+            root = root->left;
+        } else if (k == left) {
+            return root;
+        } else {
+            k -= left + 1;
+            root = root->right;
+        }
+    }
+    return nullptr;
+}
+
+// number of keys in [lo, hi]
+template <class NodeRef>
+int countRange(NodeRef root, int lo, int hi) {
+    return lo > hi ? 0 : rankOf(root, hi, true) - rankOf(root, lo);
+}
+
+template <class NodeRef>
+bool isHeightBalanced(NodeRef root) {
     if (root == nullptr) return true;
     int balance = getBalance(root);
     if (balance < -1 || balance > 1) return false;
     return isHeightBalanced(root->left) && isHeightBalanced(root->right);
 }
 
-void inorder(Node* root) {
+template <class NodeRef>
+void inorder(NodeRef root) {
     if (root == nullptr) return;
     inorder(root->left);
     cout << root->data << " ";
     inorder(root->right);
 }
 
-int main() {
-    Node* root = nullptr;
+// frees every node one by one (what a pool-less tree has to do)
+template <class NodeRef>
+void freeTree(NodeRef root) {
+    if (root == nullptr) return;
+    freeTree(root->left);
+    freeTree(root->right);
+    root.release();
+}
+
+// ---- join-based bulk operations (Blelloch, Ferizovic, Sun 2016) ----
+// join(l, k, r) links two trees whose keys are all below / above node k in
+// O(|h(l) - h(r)|), rebalancing only along the spine where they meet; split,
+// union, intersection and difference are built on it alone. They take
+// ownership of their input trees and return the result, reusing the input
+// nodes: no node is allocated, and nodes dropped from the result (duplicates,
+// non-members) are collected in `trash` and freed by the caller once the
+// operation is over, so the node pool is never touched from two threads.
+
+const int PARALLEL_HEIGHT = 14;   // fork on subtrees of ~10k nodes and more
+
+template <class NodeRef>
+NodeRef linkNode(NodeRef l, NodeRef k, NodeRef r) {
+    k->left = l;
+    k->right = r;
+    updateNode(k);
+    return k;
+}
+
+// h(l) > h(r) + 1: walk down l's right spine to a subtree of r's height
+template <class NodeRef>
+NodeRef joinRight(NodeRef l, NodeRef k, NodeRef r) {
+    NodeRef c = l->right;
+    if (height(c) <= height(r) + 1) {
+        NodeRef t = linkNode(c, k, r);
+        if (height(t) <= height(l->left) + 1) return linkNode(l->left, l, t);
+        return leftRotate(linkNode(l->left, l, rightRotate(t)));
+    }
+    NodeRef t = joinRight(c, k, r);
+    linkNode(l->left, l, t);
+    return height(t) <= height(l->left) + 1 ? l : leftRotate(l);
+}
+
+template <class NodeRef>
+NodeRef joinLeft(NodeRef l, NodeRef k, NodeRef r) {
+    NodeRef c = r->left;
+    if (height(c) <= height(l) + 1) {
+        NodeRef t = linkNode(l, k, c);
+        if (height(t) <= height(r->right) + 1) return linkNode(t, r, r->right);
+        return rightRotate(linkNode(leftRotate(t), r, r->right));
+    }
+    NodeRef t = joinLeft(l, k, c);
+    linkNode(t, r, r->right);
+    return height(t) <= height(r->right) + 1 ? r : rightRotate(r);
+}
+
+// every key of l < k->data < every key of r
+template <class NodeRef>
+NodeRef join(NodeRef l, NodeRef k, NodeRef r) {
+    if (height(l) > height(r) + 1) return joinRight(l, k, r);
+    if (height(r) > height(l) + 1) return joinLeft(l, k, r);
+    return linkNode(l, k, r);
+}
+
+template <class NodeRef>
+struct SplitResult {
+    NodeRef left, match, right;   // keys < key, the node holding key (or null), keys > key
+};
+
+template <class NodeRef>
+SplitResult<NodeRef> split(NodeRef root, int key) {
+    if (root == nullptr) return {nullptr, nullptr, nullptr};
+    NodeRef l = root->left, r = root->right;
+    if (key == root->data) {
+        root->left = root->right = nullptr;
+        return {l, root, r};
+    }
+    if (key < root->data) {
+        SplitResult<NodeRef> s = split(l, key);
+        return {s.left, s.match, join(s.right, root, r)};
+    }
+    SplitResult<NodeRef> s = split(r, key);
+    return {join(l, root, s.left), s.match, s.right};
+}
+
+// detaches the maximum node; returns the rest
+template <class NodeRef>
+NodeRef splitLast(NodeRef root, NodeRef& last) {
+    if (root->right == nullptr) {
+        last = root;
+        NodeRef l = root->left;
+        root->left = nullptr;
+        return l;
+    }
+    NodeRef r = splitLast(root->right, last);
+    return join(root->left, root, r);
+}
+
+// join without a middle key
+template <class NodeRef>
+NodeRef join2(NodeRef l, NodeRef r) {
+    if (l == nullptr) return r;
+    NodeRef last = nullptr;
+    l = splitLast(l, last);
+    return join(l, last, r);
+}
+
+template <class NodeRef>
+void appendTrash(vector<NodeRef>& trash, vector<NodeRef>& more) {
+    trash.insert(trash.end(), more.begin(), more.end());
+}
+
+// keys in a or b
+template <class NodeRef>
+NodeRef unionTrees(NodeRef a, NodeRef b, vector<NodeRef>& trash) {
+    if (a == nullptr) return b;
+    if (b == nullptr) return a;
+    SplitResult<NodeRef> s = split(b, a->data);
+    if (s.match != nullptr) trash.push_back(s.match);
+    NodeRef l, r, al = a->left, ar = a->right;
+    vector<NodeRef> trashRight;
+    forkJoin(height(a) >= PARALLEL_HEIGHT, [&] { l = unionTrees(al, s.left, trash); },
+             [&] { r = unionTrees(ar, s.right, trashRight); });
+    appendTrash(trash, trashRight);
+    return join(l, a, r);
+}
+
+// keys in both a and b
+template <class NodeRef>
+NodeRef intersectTrees(NodeRef a, NodeRef b, vector<NodeRef>& trash) {
+    if (a == nullptr || b == nullptr) {
+        if (a != nullptr || b != nullptr) trash.push_back(a == nullptr ? b : a);
+        return nullptr;
+    }
+    SplitResult<NodeRef> s = split(b, a->data);
+    NodeRef l, r, al = a->left, ar = a->right;
+    vector<NodeRef> trashRight;
+    forkJoin(height(a) >= PARALLEL_HEIGHT, [&] { l = intersectTrees(al, s.left, trash); },
+             [&] { r = intersectTrees(ar, s.right, trashRight); });
+    appendTrash(trash, trashRight);
+    if (s.match != nullptr) {
+        trash.push_back(s.match);
+        return join(l, a, r);
+    }
+    a->left = a->right = nullptr;
+    trash.push_back(a);
+    return join2(l, r);
+}
+
+// keys in a but not in b
+template <class NodeRef>
+NodeRef differenceTrees(NodeRef a, NodeRef b, vector<NodeRef>& trash) {
+    if (a == nullptr || b == nullptr) {
+        if (b != nullptr) trash.push_back(b);
+        return a;
+    }
+    SplitResult<NodeRef> s = split(a, b->data);
+    if (s.match != nullptr) trash.push_back(s.match);
+    NodeRef l, r, bl = b->left, br = b->right;
+    vector<NodeRef> trashRight;
+    forkJoin(height(b) >= PARALLEL_HEIGHT, [&] { l = differenceTrees(s.left, bl, trash); },
+             [&] { r = differenceTrees(s.right, br, trashRight); });
+    appendTrash(trash, trashRight);
+    b->left = b->right = nullptr;
+    trash.push_back(b);
+    return join2(l, r);
+}
+
+// trash holds whole subtrees (a single dropped node has no children)
+template <class NodeRef>
+void emptyTrash(vector<NodeRef>& trash) {
+    for (NodeRef t : trash) freeTree(t);
+    trash.clear();
+}
+
+template <class NodeRef>
+NodeRef setUnion(NodeRef a, NodeRef b) {
+    vector<NodeRef> trash;
+    NodeRef t = unionTrees(a, b, trash);
+    emptyTrash(trash);
+    return t;
+}
+
+template <class NodeRef>
+NodeRef setIntersection(NodeRef a, NodeRef b) {
+    vector<NodeRef> trash;
+    NodeRef t = intersectTrees(a, b, trash);
+    emptyTrash(trash);
+    return t;
+}
+
+template <class NodeRef>
+NodeRef setDifference(NodeRef a, NodeRef b) {
+    vector<NodeRef> trash;
+    NodeRef t = differenceTrees(a, b, trash);
+    emptyTrash(trash);
+    return t;
+}
+
+// perfectly balanced tree over sorted, distinct keys[first, last)
+template <class NodeRef>
+NodeRef buildSorted(const int* first, const int* last) {
+    if (first == last) return nullptr;
+    const int* mid = first + (last - first) / 2;
+    NodeRef node = NodeRef::make(*mid);
+    NodeRef l = buildSorted<NodeRef>(first, mid);
+    NodeRef r = buildSorted<NodeRef>(mid + 1, last);
+    return linkNode(l, node, r);
+}
+
+// Inserts a batch of keys (any order, duplicates allowed): sort, build a
+// tree in O(batch) and union it in, instead of one rebalancing insert per key.
+template <class NodeRef>
+NodeRef insertBatch(NodeRef root, vector<int> keys) {
+    sort(keys.begin(), keys.end());
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+    return setUnion(root, buildSorted<NodeRef>(keys.data(), keys.data() + keys.size()));
+}
+
+// n random inserts and n lookups (half hits), then teardown; with pooled
+// indices and with new / delete. ./6 bench [n]
+template <class NodeRef>
+struct BenchTree {
+    static const bool erases = false, copies = false, pooled = NodeRef::pooled;
+    NodeRef root = nullptr;
+    void insert(int k) { root = ::insert(root, k); }
+    bool contains(int k) const { return search(root, k); }
+    bool valid() const { return isHeightBalanced(root); }
+    size_t poolBytes() const {
+        if constexpr (NodeRef::pooled) return NodeRef::pool().bytes();
+        return 0;
+    }
+    void release() {
+        freeTree(root);
+        root = nullptr;
+    }
+    // every node of this type, in every tree
+    void dropPool() {
+        NodeRef::releaseAll();
+        root = nullptr;
+    }
+};
+
+void benchmark(int n) {
+    vector<int> keys = randomKeys(n);
+    printf("AVL, %d random keys\n", n);
+    runPoolBenchmark<BenchTree<PoolRef<BasicNode<PoolRef>>>>("pool", keys);
+    runPoolBenchmark<BenchTree<HeapRef<BasicNode<HeapRef>>>>("new/delete", keys);
+}
+
+
+template <class NodeRef>
+void collect(NodeRef root, vector<int>& out) {
+    if (root == nullptr) return;
+    collect(root->left, out);
+    out.push_back(root->data);
+    collect(root->right, out);
+}
+
+template <class NodeRef>
+bool sameKeys(NodeRef root, const vector<int>& expected) {
+    vector<int> got;
+    collect(root, got);
+    return got == expected && isHeightBalanced(root);
+}
+
+// Join-based union / intersection / difference of two n-key trees sharing
+// half their keys, and a batch insert of n/8 keys, against one insert per
+// key; thread count doubles up to numThreads(). ./6 setops [n]
+void setOpsBenchmark(int n) {
+    vector<int> keys = randomKeys(2 * n, 7);
+    vector<int> a(keys.begin(), keys.begin() + n), b(keys.begin() + n / 2, keys.begin() + n / 2 + n);
+    vector<int> batch(keys.begin() + n, keys.begin() + n + n / 8);
+    sort(a.begin(), a.end());
+    sort(b.begin(), b.end());
+    vector<int> sUnion, sInter, sDiff, sBatch;
+    set_union(a.begin(), a.end(), b.begin(), b.end(), back_inserter(sUnion));
+    set_intersection(a.begin(), a.end(), b.begin(), b.end(), back_inserter(sInter));
+    set_difference(a.begin(), a.end(), b.begin(), b.end(), back_inserter(sDiff));
+    sBatch = a;
+    sBatch.insert(sBatch.end(), batch.begin(), batch.end());
+    sort(sBatch.begin(), sBatch.end());
+    sBatch.erase(unique(sBatch.begin(), sBatch.end()), sBatch.end());
+
+    auto build = [](const vector<int>& v) { return buildSorted<NodeRef>(v.data(), v.data() + v.size()); };
+    printf("AVL set operations, |A| = |B| = %d, |A & B| = %zu, batch of %zu\n", n, sInter.size(), batch.size());
+
+    // baselines: B, then the batch, inserted into A one key at a time
+    NodeRef t = build(a);
+    Timer tu;
+    for (int k : b) t = insert(t, k);
+    double perKeyUnion = tu.ms();
+    bool ok = sameKeys(t, sUnion);
+    NodeRef::releaseAll();
+    t = build(a);
+    Timer tb;
+    for (int k : batch) t = insert(t, k);
+    double perKeyBatch = tb.ms();
+    ok = ok && sameKeys(t, sBatch);
+    NodeRef::releaseAll();
+    printf("per-key insert    union %8.1f ms  batch %8.1f ms  %s\n", perKeyUnion, perKeyBatch, ok ? "ok" : "WRONG");
+
+    int maxThreads = numThreads();
+    for (int th = 1;; th = min(th * 2, maxThreads)) {
+        setThreads(th);
+        double ms[4];
+        ok = true;
+        const vector<int>* expected[3] = {&sUnion, &sInter, &sDiff};
+        for (int op = 0; op < 3; op++) {
+            NodeRef x = build(a), y = build(b);
+            Timer timer;
+            NodeRef r = op == 0 ? setUnion(x, y) : op == 1 ? setIntersection(x, y) : setDifference(x, y);
+            ms[op] = timer.ms();
+            ok = ok && sameKeys(r, *expected[op]);
+            NodeRef::releaseAll();
+        }
+        NodeRef x = build(a);
+        Timer timer;
+        x = insertBatch(x, batch);
+        ms[3] = timer.ms();
+        ok = ok && sameKeys(x, sBatch);
+        NodeRef::releaseAll();
+        printf("threads %3d  union %8.1f ms (x%.1f)  intersect %8.1f ms  difference %8.1f ms  "
+               "batch %8.1f ms (x%.1f)  %s\n", th, ms[0], perKeyUnion / ms[0], ms[1], ms[2], ms[3],
+               perKeyBatch / ms[3], ok ? "ok" : "WRONG");
+        if (th == maxThreads) break;
+    }
+}
+
+// rank / select / countRange against a sorted array with binary search,
+// under 0, 1 and 10 % inserts. ./6 rank [n]
+struct RankTree {
+    NodeRef root;
+    explicit RankTree(const vector<int>& sorted) : root(buildSorted<NodeRef>(sorted.data(), sorted.data() + sorted.size())) {}
+    void insert(int k) { root = ::insert(root, k); }
+    int64_t rank(int k) const { return rankOf(root, k); }
+    int64_t select(int i) const { return selectKth(root, i)->data; }
+    int64_t countRange(int lo, int hi) const { return ::countRange(root, lo, hi); }
+    bool valid() const { return isHeightBalanced(root); }
+    void release() {
+        freeTree(root);
+        root = nullptr;
+    }
+};
+
+void rankBenchmark(int n) { runRankBenchmark<RankTree>("AVL", "avl", n); }
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "bench") {
+        benchmark(argc > 2 ? atoi(argv[2]) : 4000000);
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "rank") {
+        rankBenchmark(argc > 2 ? atoi(argv[2]) : 1000000);
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "setops") {
+        setOpsBenchmark(argc > 2 ? atoi(argv[2]) : 2000000);
+        return 0;
+    }
+
+    NodeRef root = nullptr;
     root = insert(root, 10);
     root = insert(root, 20);
     root = insert(root, 30);  // triggers RR rotation
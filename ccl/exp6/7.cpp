@@ -1,25 +1,87 @@
 #include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <iterator>
+#include <algorithm>
+#include <utility>
+#include <cstdio>
+#include <cstdlib>
+#include "node_pool.h"
+#include "bench_util.h"
 using namespace std;
 
 enum Color { RED, BLACK };
 
-struct Node {
-    int data;
+// Ref = PoolRef (32-bit pool index) or HeapRef (new / delete)
+template <class Key, class Value, template <class> class Ref>
+struct BasicNode {
+    pair<const Key, Value> kv;
     Color color;
-    Node *left, *right, *parent;
-    Node(int val) {
-        data = val;
+    unsigned size;   // nodes in this subtree (0 for NIL), for rank / select
+    Ref<BasicNode> left, right, parent;
+    BasicNode(const Key& key, const Value& value) : kv(key, value) {
         color = RED;
+        size = 1;
         left = right = parent = nullptr;
     }
 };
 
+// Ordered map with unique keys. Leaves point at a shared black NIL sentinel;
+// the root's parent is nullptr. Iterators walk parent links, so they need no
+// stack, and stay valid until their own element is erased. end() is NIL.
+template <class Key, class Value, class Compare = less<Key>, template <class> class Ref = PoolRef>
 class RedBlackTree {
-    Node* root;
-    Node* NIL;
+public:
+    using Node = BasicNode<Key, Value, Ref>;
+    using NodeRef = Ref<Node>;
+    using value_type = pair<const Key, Value>;
+
+private:
+    NodeRef root;
+    NodeRef NIL;
+    Compare comp;
+    size_t count = 0;
+
+    bool before(const Key& a, const Key& b) const { return comp(a, b); }
+
+    NodeRef minimum(NodeRef x) const {
+        while (x->left != NIL) x = x->left;
+        return x;
+    }
+
+    NodeRef maximum(NodeRef x) const {
+        while (x->right != NIL) x = x->right;
+        return x;
+    }
+
+    NodeRef successor(NodeRef x) const {
+        if (x->right != NIL) return minimum(x->right);
+        NodeRef p = x->parent;
+        while (p != nullptr && x == p->right) {
+            x = p;
+            p = p->parent;
+        }
+        return p == nullptr ? NIL : p;
+    }
+
+    NodeRef predecessor(NodeRef x) const {
+        if (x == NIL) return root == NIL ? NIL : maximum(root);
+        if (x->left != NIL) return maximum(x->left);
+        NodeRef p = x->parent;
+        while (p != nullptr && x == p->left) {
+            x = p;
+            p = p->parent;
+        }
+        return p == nullptr ? NIL : p;
+    }
+
+    void updateSize(NodeRef x) { x->size = x->left->size + x->right->size + 1; }
 
-    void leftRotate(Node* x) {
-        Node* y = x->right;
+    // rotations keep the subtree's key set, so the new top inherits its size
+    void leftRotate(NodeRef x) {
+        NodeRef y = x->right;
         x->right = y->left;
         if (y->left != NIL) y->left->parent = x;
         y->parent = x->parent;
@@ -28,10 +90,12 @@ class RedBlackTree {
         else                            x->parent->right = y;
         y->left = x;
         x->parent = y;
+        y->size = x->size;
+        updateSize(x);
     }
 
-    void rightRotate(Node* y) {
-        Node* x = y->left;
+    void rightRotate(NodeRef y) {
+        NodeRef x = y->left;
         y->left = x->right;
         if (x->right != NIL) x->right->parent = y;
         x->parent = y->parent;
@@ -40,12 +104,14 @@ class RedBlackTree {
         else                            y->parent->right = x;
         x->right = y;
         y->parent = x;
+        x->size = y->size;
+        updateSize(y);
     }
 
-    void fixInsert(Node* z) {
+    void fixInsert(NodeRef z) {
         while (z->parent != nullptr && z->parent->color == RED) {
             if (z->parent == z->parent->parent->left) {
-                Node* uncle = z->parent->parent->right;
+                NodeRef uncle = z->parent->parent->right;
                 if (uncle->color == RED) {
                     z->parent->color = BLACK;
                     uncle->color = BLACK;
@@ -61,7 +127,7 @@ class RedBlackTree {
                     rightRotate(z->parent->parent);
                 }
             } else {
-                Node* uncle = z->parent->parent->left;
+                NodeRef uncle = z->parent->parent->left;
                 if (uncle->color == RED) {
                     z->parent->color = BLACK;
                     uncle->color = BLACK;
@@ -81,8 +147,173 @@ class RedBlackTree {
         root->color = BLACK;
     }
 
+    // puts v where u was (v may be NIL; its parent is still set, fixErase needs it)
+    void transplant(NodeRef u, NodeRef v) {
+        if (u->parent == nullptr)       root = v;
+        else if (u == u->parent->left) u->parent->left  = v;
+        else                            u->parent->right = v;
+        v->parent = u->parent;
+    }
+
+    // x carries an extra black; push it up or resolve it with recolouring
+    // and at most three rotations (CLRS RB-DELETE-FIXUP)
+    void fixErase(NodeRef x) {
+        while (x != root && x->color == BLACK) {
+            if (x == x->parent->left) {
+                NodeRef w = x->parent->right;
+                if (w->color == RED) {
+                    w->color = BLACK;
+                    x->parent->color = RED;
+                    leftRotate(x->parent);
+                    w = x->parent->right;
+                }
+                if (w->left->color == BLACK && w->right->color == BLACK) {
+                    w->color = RED;
+                    x = x->parent;
+                } else {
+                    if (w->right->color == BLACK) {
+                        w->left->color = BLACK;
+                        w->color = RED;
+                        rightRotate(w);
+                        w = x->parent->right;
+                    }
+                    w->color = x->parent->color;
+                    x->parent->color = BLACK;
+                    w->right->color = BLACK;
+                    leftRotate(x->parent);
+                    x = root;
+                }
+            } else {
+                NodeRef w = x->parent->left;
+                if (w->color == RED) {
+                    w->color = BLACK;
+                    x->parent->color = RED;
+                    rightRotate(x->parent);
+                    w = x->parent->left;
+                }
+                if (w->right->color == BLACK && w->left->color == BLACK) {
+                    w->color = RED;
+                    x = x->parent;
+                } else {
+                    if (w->left->color == BLACK) {
+                        w->right->color = BLACK;
+                        w->color = RED;
+                        leftRotate(w);
+                        w = x->parent->left;
+                    }
+                    w->color = x->parent->color;
+                    x->parent->color = BLACK;
+                    w->left->color = BLACK;
+                    rightRotate(x->parent);
+                    x = root;
+                }
+            }
+        }
+        x->color = BLACK;
+    }
+
+    void eraseNode(NodeRef z) {
+        // y is the node that leaves its position: z, or z's successor
+        NodeRef y = z->left == NIL || z->right == NIL ? z : minimum(z->right), x;
+        for (NodeRef p = y->parent; p != nullptr; p = p->parent) p->size--;
+        Color removed = y->color;
+        if (z->left == NIL) {
+            x = z->right;
+            transplant(z, z->right);
+        } else if (z->right == NIL) {
+            x = z->left;
+            transplant(z, z->left);
+        } else {
+            // the successor takes z's place (nodes move, keys do not)
+            x = y->right;
+            if (y->parent == z) {
+                x->parent = y;
+            } else {
+                transplant(y, y->right);
+                y->right = z->right;
+                y->right->parent = y;
+            }
+            transplant(z, y);
+            y->left = z->left;
+            y->left->parent = y;
+            y->color = z->color;
+            y->size = z->size;
+        }
+        z.release();
+        count--;
+        if (removed == BLACK) fixErase(x);
+    }
+
+    NodeRef findNode(const Key& key) const {
+        NodeRef x = root;
+        while (x != NIL) {
+            if (before(key, x->kv.first)) x = x->left;
+            else if (before(x->kv.first, key)) x = x->right;
+            else return x;
+        }
+        return NIL;
+    }
+
+    // first node with key >= k (strict: > k)
+    NodeRef boundNode(const Key& key, bool strict) const {
+        NodeRef x = root, best = NIL;
+        while (x != NIL) {
+            if (strict ? before(key, x->kv.first) : !before(x->kv.first, key)) {
+                best = x;
+                x = x->left;
+            } else {
+                x = x->right;
+            }
+        }
+        return best;
+    }
+
+    // number of keys < key (inclusive: <= key)
+    size_t countBefore(const Key& key, bool inclusive) const {
+        size_t r = 0;
+        for (NodeRef x = root; x != NIL;) {
+            if (inclusive ? before(key, x->kv.first) : !before(x->kv.first, key)) {
+                x = x->left;
+            } else {
+                r += x->left->size + 1;
+                x = x->right;
+            }
+        }
+        return r;
+    }
+
+    NodeRef selectNode(size_t k) const {
+        if (k >= count) return NIL;
+        NodeRef x = root;
+        while (k != x->left->size) {
+            if (k < x->left->size) {
+                x = x->left;
+            } else {
+                k -= x->left->size + 1;
+                x = x->right;
+            }
+        }
+        return x;
+    }
+
+    // Balanced subtree over items[lo, hi); nodes at depth redDepth are red
+    // (only the last, partial level ends up there), so every path has the
+    // same number of black nodes.
+    template <class It>
+    NodeRef buildRange(It items, int64_t lo, int64_t hi, int depth, int redDepth, NodeRef parent) {
+        if (lo >= hi) return NIL;
+        int64_t mid = lo + (hi - lo) / 2;
+        NodeRef x = NodeRef::make(items[mid].first, items[mid].second);
+        x->color = depth == redDepth ? RED : BLACK;
+        x->size = (unsigned)(hi - lo);
+        x->parent = parent;
+        x->left = buildRange(items, lo, mid, depth + 1, redDepth, x);
+        x->right = buildRange(items, mid + 1, hi, depth + 1, redDepth, x);
+        return x;
+    }
+
     // Checks: no two consecutive red nodes, and equal black-height on all paths
-    bool checkProperties(Node* node, int blackCount, int& pathBlackCount) {
+    bool checkProperties(NodeRef node, int blackCount, int& pathBlackCount) {
         if (node == NIL) {
             if (pathBlackCount == -1) pathBlackCount = blackCount;
             return blackCount == pathBlackCount;
@@ -95,39 +326,166 @@ class RedBlackTree {
                checkProperties(node->right, blackCount, pathBlackCount);
     }
 
-    void inorder(Node* node) {
+    void freeNodes(NodeRef node) {
+        if (node == NIL) return;
+        freeNodes(node->left);
+        freeNodes(node->right);
+        node.release();
+    }
+
+    void inorder(NodeRef node) {
         if (node == NIL) return;
         inorder(node->left);
-        cout << node->data << "(" << (node->color == RED ? "R" : "B") << ") ";
+        cout << node->kv.first << "(" << (node->color == RED ? "R" : "B") << ") ";
         inorder(node->right);
     }
 
 public:
+    template <bool IsConst>
+    class Iterator {
+        friend class RedBlackTree;
+        const RedBlackTree* tree = nullptr;
+        NodeRef node;
+        Iterator(const RedBlackTree* t, NodeRef n) : tree(t), node(n) {}
+
+    public:
+        using iterator_category = bidirectional_iterator_tag;
+        using value_type = RedBlackTree::value_type;
+        using difference_type = ptrdiff_t;
+        using reference = conditional_t<IsConst, const value_type&, value_type&>;
+        using pointer = conditional_t<IsConst, const value_type*, value_type*>;
+
+        Iterator() = default;
+        // iterator -> const_iterator
+        template <bool C = IsConst, class = enable_if_t<C>>
+        Iterator(const Iterator<false>& o) : tree(o.tree), node(o.node) {}
+
+        reference operator*() const { return node->kv; }
+        pointer operator->() const { return &node->kv; }
+        Iterator& operator++() { node = tree->successor(node); return *this; }
+        Iterator& operator--() { node = tree->predecessor(node); return *this; }
+        Iterator operator++(int) { Iterator old = *this; ++*this; return old; }
+        Iterator operator--(int) { Iterator old = *this; --*this; return old; }
+        bool operator==(const Iterator& o) const { return node == o.node; }
+        bool operator!=(const Iterator& o) const { return node != o.node; }
+    };
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
     RedBlackTree() {
-        NIL = new Node(0);
+        NIL = NodeRef::make(Key(), Value());
         NIL->color = BLACK;
+        NIL->size = 0;
         root = NIL;
     }
 
-    void insert(int key) {
-        Node* z = new Node(key);
-        z->left = z->right = NIL;
+    // Linear-time build from items sorted by strictly increasing key.
+    template <class It>
+    static RedBlackTree fromSorted(It first, It last) {
+        RedBlackTree t;
+        int64_t n = distance(first, last);
+        int perfect = 0;    // depth of the last full level
+        while (((int64_t)2 << perfect) - 1 <= n) perfect++;
+        t.root = t.buildRange(first, 0, n, 0, perfect, nullptr);
+        t.count = (size_t)n;
+        return t;
+    }
+
+    RedBlackTree(RedBlackTree&& o) noexcept : root(o.root), NIL(o.NIL), comp(o.comp), count(o.count) {
+        o.root = o.NIL = nullptr;
+        o.count = 0;
+    }
+    RedBlackTree(const RedBlackTree&) = delete;
+    RedBlackTree& operator=(const RedBlackTree&) = delete;
+
+    ~RedBlackTree() {
+        if (NIL == nullptr) return;
+        freeNodes(root);
+        NIL.release();
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
 
-        Node* y = nullptr;
-        Node* x = root;
+    iterator begin() { return {this, root == NIL ? NIL : minimum(root)}; }
+    iterator end() { return {this, NIL}; }
+    const_iterator begin() const { return {this, root == NIL ? NIL : minimum(root)}; }
+    const_iterator end() const { return {this, NIL}; }
 
+    // {position, true} if inserted; {existing, false} if the key was present
+    pair<iterator, bool> insert(const Key& key, const Value& value = Value()) {
+        NodeRef y = nullptr;
+        NodeRef x = root;
         while (x != NIL) {
             y = x;
-            if (z->data < x->data) x = x->left;
-            else x = x->right;
+            if (before(key, x->kv.first)) x = x->left;
+            else if (before(x->kv.first, key)) x = x->right;
+            else return {iterator(this, x), false};
         }
+
+        // key may refer into the node pool, which make() can move
+        bool leftChild = y != nullptr && before(key, y->kv.first);
+        NodeRef z = NodeRef::make(key, value);
+        z->left = z->right = NIL;
         z->parent = y;
 
-        if (y == nullptr)           root = z;
-        else if (z->data < y->data) y->left  = z;
-        else                        y->right = z;
+        if (y == nullptr)  root = z;
+        else if (leftChild) y->left  = z;
+        else               y->right = z;
 
+        for (NodeRef p = y; p != nullptr; p = p->parent) p->size++;
+        count++;
         fixInsert(z);
+        return {iterator(this, z), true};
+    }
+
+    iterator find(const Key& key) { return {this, findNode(key)}; }
+    const_iterator find(const Key& key) const { return {this, findNode(key)}; }
+    bool contains(const Key& key) const { return findNode(key) != NIL; }
+
+    iterator lower_bound(const Key& key) { return {this, boundNode(key, false)}; }
+    iterator upper_bound(const Key& key) { return {this, boundNode(key, true)}; }
+    const_iterator lower_bound(const Key& key) const { return {this, boundNode(key, false)}; }
+    const_iterator upper_bound(const Key& key) const { return {this, boundNode(key, true)}; }
+
+    // Order statistics in O(log n) through the subtree sizes.
+    // rank: number of keys < key; select: the k-th smallest (0-based), end()
+    // if k >= size(); countRange: number of keys in [lo, hi].
+    size_t rank(const Key& key) const { return countBefore(key, false); }
+    iterator select(size_t k) { return {this, selectNode(k)}; }
+    const_iterator select(size_t k) const { return {this, selectNode(k)}; }
+    size_t countRange(const Key& lo, const Key& hi) const {
+        return before(hi, lo) ? 0 : countBefore(hi, true) - countBefore(lo, false);
+    }
+
+    // returns the element after the erased one
+    iterator erase(iterator pos) {
+        NodeRef next = successor(pos.node);
+        eraseNode(pos.node);
+        return {this, next};
+    }
+
+    // number of elements removed (0 or 1)
+    size_t erase(const Key& key) {
+        NodeRef z = findNode(key);
+        if (z == NIL) return 0;
+        eraseNode(z);
+        return 1;
+    }
+
+    // frees the nodes one by one
+    void clear() {
+        freeNodes(root);
+        root = NIL;
+        count = 0;
+    }
+
+    // O(1) teardown for pooled nodes: drops the whole pool, i.e. every tree
+    // of this node type; this tree is unusable afterwards.
+    void releasePool() {
+        NodeRef::releaseAll();
+        root = NIL = nullptr;
+        count = 0;
     }
 
     bool isValidRBTree() {
@@ -140,8 +498,146 @@ public:
     void inorder() { inorder(root); cout << endl; }
 };
 
-int main() {
-    RedBlackTree rbt;
+// n random inserts and n lookups (half hits), a tree to tree copy, then
+// teardown; with pooled indices and with new / delete. ./7 pool [n]
+template <template <class> class Ref>
+struct PoolBenchTree {
+    using Tree = RedBlackTree<int, int, less<int>, Ref>;
+    static const bool erases = false, copies = true, pooled = Tree::NodeRef::pooled;
+    Tree t;
+    void insert(int k) { t.insert(k); }
+    bool contains(int k) const { return t.contains(k); }
+    bool valid() { return t.isValidRBTree(); }
+    // with pooled nodes the source keys live in the pool that grows under
+    // the inserts
+    bool copyInto() {
+        Tree copy;
+        for (auto& kv : t) copy.insert(kv.first, kv.second);
+        return copy.size() == t.size() && copy.isValidRBTree() && equal(copy.begin(), copy.end(), t.begin(), t.end());
+    }
+    size_t poolBytes() const {
+        if constexpr (Tree::NodeRef::pooled) return Tree::NodeRef::pool().bytes();
+        return 0;
+    }
+    void release() { t.clear(); }
+    void dropPool() { t.releasePool(); }
+};
+
+void poolBenchmark(int n) {
+    vector<int> keys = randomKeys(n);
+    printf("red-black tree, %d random keys\n", n);
+    runPoolBenchmark<PoolBenchTree<PoolRef>>("pool", keys);
+    runPoolBenchmark<PoolBenchTree<HeapRef>>("new/delete", keys);
+}
+
+// RedBlackTree<int, int> vs std::map<int, int>: random inserts, lookups
+// (half hits), an ordered scan, erasing half the keys, and building from
+// sorted input. ./7 bench [n]
+void benchmark(int n) {
+    vector<int> keys = randomKeys(n);
+    vector<pair<int, int>> sorted;
+    for (int i = 0; i < n; i++) sorted.push_back({2 * i + 1, i});
+
+    printf("%d keys, Mops (build: ms)\n", n);
+    printf("%-10s %9s %9s %9s %9s %11s\n", "", "insert", "lookup", "scan", "erase", "build");
+
+    auto run = [&](const char* name, auto& m, auto buildSorted) {
+        Timer ti;
+        for (int k : keys) m.insert({k, k});
+        double insertMs = ti.ms();
+
+        Timer tl;
+        int64_t hits = 0;
+        for (int i = 0; i < n; i++) hits += m.find(keys[i] + (i & 1)) != m.end();
+        double lookupMs = tl.ms();
+
+        Timer ts;
+        int64_t sum = 0, prev = -1;
+        bool ordered = true;
+        for (auto& kv : m) {
+            ordered = ordered && kv.first > prev;
+            prev = kv.first;
+            sum += kv.second;
+        }
+        double scanMs = ts.ms();
+
+        Timer te;
+        for (int i = 0; i < n / 2; i++) m.erase(keys[i]);
+        double eraseMs = te.ms();
+        bool ok = hits == (n + 1) / 2 && ordered && (int64_t)m.size() == n - n / 2;
+
+        Timer tb;
+        size_t built = buildSorted();
+        double buildMs = tb.ms();
+        ok = ok && built == (size_t)n && sum >= 0;
+
+        printf("%-10s %9.2f %9.2f %9.2f %9.2f %11.1f  %s\n", name, mops(n, insertMs), mops(n, lookupMs),
+               mops(n, scanMs), mops(n / 2, eraseMs), buildMs, ok ? "ok" : "WRONG");
+    };
+
+    {
+        RedBlackTree<int, int> t;
+        // the tree's insert takes key and value separately
+        struct Adapter {
+            RedBlackTree<int, int>& t;
+            void insert(const pair<int, int>& kv) { t.insert(kv.first, kv.second); }
+            auto find(int k) { return t.find(k); }
+            auto begin() { return t.begin(); }
+            auto end() { return t.end(); }
+            void erase(int k) { t.erase(k); }
+            size_t size() const { return t.size(); }
+        } a{t};
+        run("rb-tree", a, [&] {
+            auto built = RedBlackTree<int, int>::fromSorted(sorted.begin(), sorted.end());
+            return built.isValidRBTree() ? built.size() : 0;
+        });
+    }
+    {
+        map<int, int> m;
+        run("std::map", m, [&] {
+            map<int, int> built(sorted.begin(), sorted.end());
+            return built.size();
+        });
+    }
+}
+
+// rank / select / countRange against a sorted array with binary search,
+// under 0, 1 and 10 % inserts. ./7 rank [n]
+struct RankTree {
+    RedBlackTree<int, int> t;
+    explicit RankTree(const vector<int>& sorted) : t(build(sorted)) {}
+    static RedBlackTree<int, int> build(const vector<int>& sorted) {
+        vector<pair<int, int>> items;
+        for (int k : sorted) items.push_back({k, 0});
+        return RedBlackTree<int, int>::fromSorted(items.begin(), items.end());
+    }
+    void insert(int k) { t.insert(k); }
+    int64_t rank(int k) const { return t.rank(k); }
+    int64_t select(int i) const { return t.select(i)->first; }
+    int64_t countRange(int lo, int hi) const { return t.countRange(lo, hi); }
+    bool valid() { return t.isValidRBTree(); }
+    void release() { t.clear(); }
+};
+
+void rankBenchmark(int n) { runRankBenchmark<RankTree>("red-black tree", "rb-tree", n); }
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "bench") {
+        benchmark(argc > 2 ? atoi(argv[2]) : 2000000);
+        return 0;
+    }
+
+    if (argc > 1 && string(argv[1]) == "rank") {
+        rankBenchmark(argc > 2 ? atoi(argv[2]) : 1000000);
+        return 0;
+    }
+
+    if (argc > 1 && string(argv[1]) == "pool") {
+        poolBenchmark(argc > 2 ? atoi(argv[2]) : 4000000);
+        return 0;
+    }
+
+    RedBlackTree<int, int> rbt;
     rbt.insert(10);
     rbt.insert(20);
     rbt.insert(30);
@@ -154,4 +650,4 @@ int main() {
     cout << "Is valid Red-Black Tree: " << (rbt.isValidRBTree() ? "Yes" : "No") << endl;
 
     return 0;
-}
\ No newline at end of file
+}
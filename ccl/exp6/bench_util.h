@@ -0,0 +1,188 @@
+// Timer, key generation, heap accounting and the shared benchmark runners for
+// the `bench` modes of the exp6 tree programs. Everything is seeded, so runs
+// are repeatable.
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <malloc.h>
+
+struct Timer {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double ms() const {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+// n distinct keys in random order
+inline std::vector<int> randomKeys(int n, uint64_t seed = 1) {
+    std::vector<int> keys(n);
+    for (int i = 0; i < n; i++) keys[i] = 2 * i + 1;   // odd, so even keys are misses
+    std::shuffle(keys.begin(), keys.end(), std::mt19937_64(seed));
+    return keys;
+}
+
+// bytes handed out by malloc, including its per-block headers and the big
+// blocks it serves with mmap, so node memory can be compared however the
+// nodes were allocated
+inline size_t heapBytesInUse() {
+    struct mallinfo2 mi = mallinfo2();
+    return mi.uordblks + mi.hblkhd;
+}
+
+// million operations per second
+inline double mops(int64_t ops, double ms) { return ops / ms / 1000.0; }
+
+// ---- mixed update / order-statistic workload for the rank benchmarks ----
+
+struct RankOp {
+    char kind;   // 'i' insert a, 'r' rank(a), 's' select(a), 'c' countRange(a, b)
+    int a, b;
+};
+
+// `initial` odd keys are loaded first (randomKeys(initial)); then `ops`
+// operations, each an insert of a fresh (even) key with probability
+// updatePct / 100, otherwise rank, select and countRange in turn.
+inline std::vector<RankOp> rankWorkload(int initial, int ops, int updatePct, uint64_t seed = 2) {
+    std::mt19937_64 rng(seed);
+    std::vector<int> fresh(std::max(initial, ops));
+    for (size_t i = 0; i < fresh.size(); i++) fresh[i] = 2 * (int)i;
+    std::shuffle(fresh.begin(), fresh.end(), rng);
+    std::vector<RankOp> w;
+    w.reserve(ops);
+    int size = initial, inserted = 0, query = 0;
+    for (int i = 0; i < ops; i++) {
+        int key = (int)(rng() % (2 * (uint64_t)initial + 1));
+        if ((int)(rng() % 100) < updatePct) {
+            w.push_back({'i', fresh[inserted++], 0});
+            size++;
+            continue;
+        }
+        switch (query++ % 3) {
+            case 0: w.push_back({'r', key, 0}); break;
+            case 1: w.push_back({'s', (int)(rng() % size), 0}); break;
+            default: w.push_back({'c', key, key + 1000}); break;
+        }
+    }
+    return w;
+}
+
+// Runs the workload on an index with insert / rank / select / countRange and
+// returns a checksum of the answers, so different indexes can be compared.
+template <class Index>
+int64_t runRankWorkload(Index& index, const std::vector<RankOp>& w) {
+    int64_t sum = 0;
+    for (const RankOp& op : w) {
+        switch (op.kind) {
+            case 'i': index.insert(op.a); break;
+            case 'r': sum += index.rank(op.a); break;
+            case 's': sum += index.select(op.a); break;
+            default: sum += index.countRange(op.a, op.b); break;
+        }
+    }
+    return sum;
+}
+
+// the baseline: a sorted array, binary search for queries, memmove for inserts
+struct SortedVectorIndex {
+    std::vector<int> v;
+    explicit SortedVectorIndex(std::vector<int> keys) : v(std::move(keys)) { std::sort(v.begin(), v.end()); }
+    void insert(int k) {
+        auto it = std::lower_bound(v.begin(), v.end(), k);
+        if (it == v.end() || *it != k) v.insert(it, k);
+    }
+    int64_t rank(int k) const { return std::lower_bound(v.begin(), v.end(), k) - v.begin(); }
+    int64_t select(int i) const { return v[i]; }
+    int64_t countRange(int lo, int hi) const {
+        return std::upper_bound(v.begin(), v.end(), hi) - std::lower_bound(v.begin(), v.end(), lo);
+    }
+};
+
+// ---- pooled nodes vs new / delete ----
+
+// n random inserts, n lookups (half hits), then teardown, on one Tree
+// adapter around a tree instantiated with PoolRef or HeapRef. The adapter
+// provides insert(k), contains(k), valid(), poolBytes() (memory malloc does
+// not see) and release() (free this tree's nodes); when `pooled`, also
+// dropPool(), which releases the node type's whole pool, i.e. every tree of
+// that type. `erases` adds n/2 deletes via erase(k), `copies` times
+// copyInto() (copy into a fresh tree and check it).
+template <class Tree>
+void runPoolBenchmark(const char* name, const std::vector<int>& keys) {
+    int n = (int)keys.size();
+    size_t heapBefore = heapBytesInUse();
+    Tree tree;
+
+    Timer ti;
+    for (int k : keys) tree.insert(k);
+    double insertMs = ti.ms();
+    double bytesPerKey = (double)(heapBytesInUse() - heapBefore + tree.poolBytes()) / n;
+
+    Timer tl;
+    int hits = 0;
+    for (int i = 0; i < n; i++) hits += tree.contains(keys[i] + (i & 1));
+    double lookupMs = tl.ms();
+    bool ok = hits == (n + 1) / 2;
+
+    double deleteMs = 0, copyMs = 0;
+    if constexpr (Tree::erases) {
+        Timer td;
+        for (int i = 0; i < n / 2; i++) tree.erase(keys[i]);
+        deleteMs = td.ms();
+    }
+    ok = ok && tree.valid();
+    if constexpr (Tree::copies) {
+        Timer tc;
+        ok = tree.copyInto() && ok;
+        copyMs = tc.ms();
+    }
+
+    // the only tree of its node type here, so a pooled one can drop the
+    // whole pool instead of freeing node by node
+    Timer tf;
+    if constexpr (Tree::pooled) tree.dropPool();
+    else tree.release();
+    double freeMs = tf.ms();
+
+    printf("%-10s %8.1f B/key  insert %6.2f Mops  lookup %6.2f Mops", name, bytesPerKey, mops(n, insertMs),
+           mops(n, lookupMs));
+    if (Tree::erases) printf("  delete %6.2f Mops", mops(n / 2, deleteMs));
+    if (Tree::copies) printf("  copy %6.2f Mops", mops(n, copyMs));
+    printf("  free all %8.1f ms  %s\n", freeMs, ok ? "ok" : "WRONG");
+}
+
+// ---- order statistics vs a sorted array ----
+
+// rank / select / countRange on an order-statistic tree and on
+// SortedVectorIndex, under 0, 1 and 10 % inserts. Index is built from the
+// sorted keys and adds valid() and release() (free its nodes) to the
+// runRankWorkload interface; `title` and `column` name it in the output.
+template <class Index>
+void runRankBenchmark(const char* title, const char* column, int n) {
+    std::vector<int> keys = randomKeys(n);
+    std::sort(keys.begin(), keys.end());
+    int ops = std::max(1, n / 4);
+    printf("%s order statistics, %d keys, %d operations, Mops\n", title, n, ops);
+    for (int pct : {0, 1, 10}) {
+        std::vector<RankOp> w = rankWorkload(n, ops, pct);
+        Index tree(keys);
+        Timer tt;
+        int64_t treeSum = runRankWorkload(tree, w);
+        double treeMs = tt.ms();
+        bool ok = tree.valid();
+        tree.release();
+
+        SortedVectorIndex sorted(keys);
+        Timer ts;
+        int64_t sortedSum = runRankWorkload(sorted, w);
+        double sortedMs = ts.ms();
+
+        printf("%3d%% inserts  %s %8.2f  sorted array %8.2f  %s\n", pct, column, mops(ops, treeMs),
+               mops(ops, sortedMs), ok && treeSum == sortedSum ? "ok" : "MISMATCH");
+    }
+}
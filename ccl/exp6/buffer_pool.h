@@ -0,0 +1,310 @@
+// Fixed-size pages in a file, cached in a fixed number of in-memory frames.
+// This is the storage layer for trees bigger than RAM that also outlive
+// the process.
+//
+// BufferPool does the usual buffer-manager work:
+//  - pin(page) / unpin(page, dirty). A pinned frame is never evicted.
+//  - CLOCK replacement: each frame has a reference bit, and the hand clears
+//    it once before it evicts that frame.
+//  - Dirty frames are written back with pwrite when evicted or on flush().
+// Page 0 holds the pool's own header (page count, free list); the bytes
+// after it are there for the user, e.g. a tree's root page id. Freed pages
+// are chained through their first four bytes and reused first. Reads and
+// writes use O_DIRECT when the file system supports it (frames are page
+// aligned), so the OS page cache does not hold a second copy.
+//
+// PageRef<T> makes tree code written against node pointers run on pages,
+// with the same interface as PoolRef / HeapRef (node_pool.h). It is a
+// 32-bit page id, so nodes can store it, and page 0 plays nullptr. To keep
+// the tree code unchanged, a dereference pins its page inside an Operation
+// scope, which holds on to the last WINDOW distinct pages it touched: one
+// more unpins the oldest, and the rest are unpinned when the operation ends.
+// A dereference is only used within one statement, which touches at most
+// three nodes, so a walk over the whole tree (traverse) keeps no more than
+// WINDOW frames pinned. Going back to a page pins it again, from its frame
+// or from the file. In a write operation the pages touched are also marked
+// dirty; this over-approximates, since nodes that were only read get written
+// back too.
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+struct BufferStats {
+    int64_t hits = 0;       // page requests served from a frame
+    int64_t reads = 0;      // page requests that had to read the file
+    int64_t writes = 0;     // pages written back
+    int64_t operations = 0;
+    double hitRatio() const { return hits + reads == 0 ? 0 : (double)hits / (hits + reads); }
+};
+
+class BufferPool {
+public:
+    static const size_t PAGE = 4096;
+    static const size_t USER_OFFSET = 64;   // start of the user part of page 0
+    static const int WINDOW = 8;            // pages an operation keeps pinned
+
+private:
+    static const uint32_t NO_PAGE = UINT32_MAX;
+    static const uint64_t MAGIC = 0x31736567617065ull;   // "epages1"
+
+    struct Header {
+        uint64_t magic;
+        uint32_t pageCount;
+        uint32_t freeHead;   // 0 = none
+    };
+
+    struct Frame {
+        uint32_t page = NO_PAGE;
+        int pins = 0;
+        bool dirty = false;
+        bool referenced = false;
+        bool held = false;    // one of the pins is the current operation's (see access)
+    };
+
+    int fd = -1;
+    bool direct = false;
+    char* memory = nullptr;
+    std::vector<Frame> frames;
+    std::vector<int32_t> frameOf;   // page id -> frame, -1 if not cached
+    size_t hand = 0;
+    bool writing = false;
+    std::vector<int> operationPins = std::vector<int>(WINDOW, -1);   // ring of held frames
+    size_t nextPin = 0;
+    Header* header = nullptr;       // lives in page 0's frame, pinned for good
+
+    char* frameData(int f) const { return memory + (size_t)f * PAGE; }
+
+    void writeBack(int f) {
+        Frame& fr = frames[f];
+        if (pwrite(fd, frameData(f), PAGE, (off_t)fr.page * PAGE) != (ssize_t)PAGE)
+            throw std::runtime_error("BufferPool: write failed");
+        fr.dirty = false;
+        stats.writes++;
+    }
+
+    int victim() {
+        for (size_t sweep = 0; sweep < 2 * frames.size() + 1; sweep++) {
+            int f = (int)hand;
+            hand = (hand + 1) % frames.size();
+            Frame& fr = frames[f];
+            if (fr.page == NO_PAGE) return f;
+            if (fr.pins > 0) continue;
+            if (fr.referenced) {
+                fr.referenced = false;
+                continue;
+            }
+            if (fr.dirty) writeBack(f);
+            frameOf[fr.page] = -1;
+            fr.page = NO_PAGE;
+            return f;
+        }
+        throw std::runtime_error("BufferPool: every frame is pinned");
+    }
+
+    // a frame for `page`, read from the file unless it is new
+    int load(uint32_t page, bool fresh) {
+        int f = victim();
+        if (fresh) {
+            memset(frameData(f), 0, PAGE);
+        } else {
+            if (pread(fd, frameData(f), PAGE, (off_t)page * PAGE) != (ssize_t)PAGE)
+                throw std::runtime_error("BufferPool: read failed");
+            stats.reads++;
+        }
+        if (page >= frameOf.size()) frameOf.resize(std::max<size_t>(page + 1, frameOf.size() * 2), -1);
+        frameOf[page] = f;
+        frames[f] = Frame();
+        frames[f].page = page;
+        frames[f].dirty = fresh;
+        return f;
+    }
+
+    int pinFrame(uint32_t page, bool fresh = false) {
+        int f = page < frameOf.size() ? frameOf[page] : -1;
+        if (f < 0) f = load(page, fresh);
+        else if (!fresh) stats.hits++;
+        frames[f].pins++;
+        frames[f].referenced = true;
+        return f;
+    }
+
+    // drops an operation's pin on frame f (-1: slot unused)
+    void release(int& f) {
+        if (f < 0) return;
+        frames[f].pins--;
+        frames[f].held = false;
+        f = -1;
+    }
+
+public:
+    BufferStats stats;
+
+    // Opens (or creates) the page file with `frameCount` frames of memory.
+    // Only an empty file is initialised; anything else must be a page file.
+    BufferPool(const std::string& path, size_t frameCount) : frames(std::max<size_t>(frameCount, 16)) {
+        fd = open(path.c_str(), O_RDWR | O_CREAT | O_DIRECT, 0644);
+        direct = fd >= 0;
+        if (!direct) fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) throw std::runtime_error("BufferPool: cannot open " + path);
+        // the destructor does not run for a constructor that throws
+        try {
+            if (posix_memalign((void**)&memory, PAGE, frames.size() * PAGE) != 0) throw std::bad_alloc();
+            off_t size = lseek(fd, 0, SEEK_END);
+            if (size < 0) throw std::runtime_error("BufferPool: cannot size " + path);
+            bool fresh = size == 0;
+            if (!fresh && size < (off_t)PAGE) throw std::runtime_error("BufferPool: not a page file " + path);
+
+            int f = pinFrame(0, fresh);   // never unpinned
+            header = (Header*)frameData(f);
+            if (fresh) {
+                *header = {MAGIC, 1, 0};
+            } else if (header->magic != MAGIC || header->pageCount == 0 || header->freeHead >= header->pageCount) {
+                throw std::runtime_error("BufferPool: not a page file " + path);
+            }
+        } catch (...) {
+            close(fd);
+            free(memory);
+            throw;
+        }
+    }
+
+    ~BufferPool() {
+        if (fd < 0) return;
+        try { flush(); } catch (...) {}
+        close(fd);
+        free(memory);
+    }
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    bool directIo() const { return direct; }
+    uint32_t pageCount() const { return header->pageCount; }
+    size_t frameCount() const { return frames.size(); }
+
+    // page 0 past the pool header; call markHeaderDirty() after changing it
+    char* userHeader() { return (char*)header + USER_OFFSET; }
+    void markHeaderDirty() { frames[frameOf[0]].dirty = true; }
+
+    char* pin(uint32_t page) { return frameData(pinFrame(page)); }
+
+    void unpin(uint32_t page, bool dirty) {
+        Frame& fr = frames[frameOf[page]];
+        fr.pins--;
+        fr.dirty = fr.dirty || dirty;
+    }
+
+    // a zeroed page, from the free list or the end of the file (not pinned)
+    uint32_t allocatePage() {
+        uint32_t page = header->freeHead;
+        if (page != 0) {
+            char* data = pin(page);
+            memcpy(&header->freeHead, data, sizeof(uint32_t));
+            memset(data, 0, PAGE);
+            unpin(page, true);
+        } else {
+            page = header->pageCount++;
+            pinFrame(page, true);
+            unpin(page, true);
+        }
+        markHeaderDirty();
+        return page;
+    }
+
+    void freePage(uint32_t page) {
+        char* data = pin(page);
+        memcpy(data, &header->freeHead, sizeof(uint32_t));
+        header->freeHead = page;
+        unpin(page, true);
+        markHeaderDirty();
+    }
+
+    void flush() {
+        for (size_t f = 0; f < frames.size(); f++)
+            if (frames[f].page != NO_PAGE && frames[f].dirty) writeBack((int)f);
+        fdatasync(fd);
+    }
+
+    // ---- operation-scoped pinning, for PageRef ----
+
+    // Begins an operation; ends (unpinning its pages) when destroyed.
+    class Operation {
+        BufferPool& pool;
+
+    public:
+        Operation(BufferPool& p, bool write) : pool(p) {
+            pool.writing = write;
+            pool.stats.operations++;
+        }
+        ~Operation() {
+            for (int& f : pool.operationPins) pool.release(f);
+            pool.writing = false;
+        }
+        Operation(const Operation&) = delete;
+        Operation& operator=(const Operation&) = delete;
+    };
+
+    // the page's frame, pinned until the current operation has touched
+    // WINDOW other pages since, or ends
+    char* access(uint32_t page) {
+        int f = page < frameOf.size() ? frameOf[page] : -1;
+        if (f < 0 || !frames[f].held) {
+            f = pinFrame(page);
+            int& slot = operationPins[nextPin];
+            nextPin = (nextPin + 1) % WINDOW;
+            release(slot);
+            slot = f;
+            frames[f].held = true;
+        }
+        if (writing) frames[f].dirty = true;
+        return frameData(f);
+    }
+};
+
+// Pointer-like 32-bit page id into the BufferPool bound to T nodes.
+template <class T>
+class PageRef {
+    uint32_t id = 0;
+
+public:
+    static const bool pooled = false;
+    // every dereference goes through the single-threaded BufferPool
+    static const bool concurrent = false;
+    static inline BufferPool* store = nullptr;   // bound by the tree that owns the file
+
+    PageRef() = default;
+    PageRef(std::nullptr_t) {}
+    explicit PageRef(uint32_t page) : id(page) {}
+
+    template <class... Args>
+    static PageRef make(Args&&... args) {
+        static_assert(sizeof(T) <= BufferPool::PAGE, "a node must fit in one page");
+        PageRef r(store->allocatePage());
+        new (store->access(r.id)) T(std::forward<Args>(args)...);
+        return r;
+    }
+    void release() {
+        (**this).~T();
+        store->freePage(id);
+    }
+
+    T* operator->() const { return (T*)store->access(id); }
+    T& operator*() const { return *(T*)store->access(id); }
+    uint32_t index() const { return id; }
+
+    bool operator==(const PageRef& o) const { return id == o.id; }
+    bool operator!=(const PageRef& o) const { return id != o.id; }
+    bool operator==(std::nullptr_t) const { return id == 0; }
+    bool operator!=(std::nullptr_t) const { return id != 0; }
+};
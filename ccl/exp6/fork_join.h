@@ -0,0 +1,62 @@
+// Recursive fork-join for the parallel exp6 tree operations (std::thread
+// only, so the files still build with a plain `g++ file.cpp`).
+//
+// forkJoin(big, a, b) runs b on a fresh thread while the caller runs a, as
+// long as fewer than numThreads() threads are busy; otherwise, or when the
+// subproblem is not `big`, both run inline. Divide-and-conquer code calls it
+// at every level and only the top levels end up forking.
+//
+// Thread count defaults to the hardware concurrency and can be pinned with
+// the EXP6_THREADS environment variable.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+#include <utility>
+
+inline int numThreads() {
+    static int t = [] {
+        const char* env = getenv("EXP6_THREADS");
+        int n = env ? atoi(env) : (int)std::thread::hardware_concurrency();
+        return std::max(1, n);
+    }();
+    return t;
+}
+
+// threads that may still be started; the caller of the top-level operation
+// is the first worker
+inline std::atomic<int>& spareThreads() {
+    static std::atomic<int> spare(numThreads() - 1);
+    return spare;
+}
+
+// only between parallel operations
+inline void setThreads(int n) { spareThreads() = std::max(1, n) - 1; }
+
+template <class A, class B>
+void forkJoin(bool big, A&& a, B&& b) {
+    if (big && spareThreads().fetch_sub(1) > 0) {
+        std::thread t(std::forward<B>(b));
+        a();
+        t.join();
+        spareThreads()++;
+        return;
+    }
+    if (big) spareThreads()++;
+    a();
+    b();
+}
+
+// fn(i) for every i in [begin, end), halving the range across threads
+// down to `grain` indices
+template <class Fn>
+void parallelFor(size_t begin, size_t end, size_t grain, const Fn& fn) {
+    if (end - begin <= std::max<size_t>(grain, 1)) {
+        for (size_t i = begin; i < end; i++) fn(i);
+        return;
+    }
+    size_t mid = begin + (end - begin) / 2;
+    forkJoin(true, [&] { parallelFor(begin, mid, grain, fn); }, [&] { parallelFor(mid, end, grain, fn); });
+}
@@ -0,0 +1,231 @@
+// Read-only search structures over a sorted set of int keys, for lookup
+// tables that are built once (e.g. frozen from a BST) and then only queried.
+// Both store the keys of an implicit, perfectly balanced search tree in a
+// flat array, so a lookup touches no pointers:
+//
+//  - EytzingerSet: BFS order, node k has children 2k and 2k + 1. The four
+//    levels below a node share one cache line, so that line is prefetched
+//    while the current level is compared; no padding is needed.
+//  - VebSet: van Emde Boas order, the tree is cut at half its height and the
+//    top and every bottom subtree are laid out recursively, so any subtree of
+//    height h spans O(1) blocks at every cache level. The tree is padded to
+//    2^h - 1 slots with INT_MAX (keys themselves may be anything).
+//
+// Lookups are branch-free: every query of a set runs the same number of
+// compare-and-descend steps. containsBatch runs a group of queries in
+// lockstep, one level at a time, prefetching each query's next node before
+// moving on to the next query, so up to GROUP cache misses are in flight.
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace frozen_detail {
+
+const int GROUP = 16;   // queries in flight per batch
+
+// 64-byte aligned int array, so prefetch arithmetic lines up with cache lines
+class AlignedInts {
+    int* p = nullptr;
+    size_t n = 0;
+
+public:
+    AlignedInts() = default;
+    explicit AlignedInts(size_t count) : n(count) {
+        size_t bytes = (count * sizeof(int) + 63) & ~(size_t)63;
+        p = (int*)aligned_alloc(64, std::max<size_t>(bytes, 64));
+        if (p == nullptr) throw std::bad_alloc();
+    }
+    AlignedInts(AlignedInts&& o) noexcept : p(o.p), n(o.n) { o.p = nullptr; o.n = 0; }
+    AlignedInts& operator=(AlignedInts&& o) noexcept {
+        std::swap(p, o.p);
+        std::swap(n, o.n);
+        return *this;
+    }
+    ~AlignedInts() { free(p); }
+    int& operator[](size_t i) { return p[i]; }
+    const int& operator[](size_t i) const { return p[i]; }
+    const int* data() const { return p; }
+    size_t size() const { return n; }
+};
+
+// number of levels of the smallest complete tree with at least n nodes
+inline int levelsFor(size_t n) {
+    int h = 0;
+    while (((size_t)1 << h) - 1 < n) h++;
+    return h;
+}
+
+}  // namespace frozen_detail
+
+class EytzingerSet {
+    frozen_detail::AlignedInts b;   // b[1..n]; b[0] unused
+    size_t n = 0;
+    int fullLevels = 0;             // levels that every search passes through
+
+    // in-order walk of the implicit tree, handing out sorted keys
+    size_t fill(const int* sorted, size_t i, size_t k) {
+        if (k > n) return i;
+        i = fill(sorted, i, 2 * k);
+        b[k] = sorted[i++];
+        return fill(sorted, i, 2 * k + 1);
+    }
+
+    // the path bits end with ...0 1...1 after the node where the search last
+    // went left, i.e. the first key >= x (0 if there is none)
+    static size_t lowerBoundIndex(size_t k) { return k >> __builtin_ffsll(~k); }
+
+    // the last, partial level: only some queries still have a node there
+    size_t lastStep(size_t k, int x) const {
+        int less = b[std::min(k, n)] < x;
+        return k <= n ? 2 * k + less : k;
+    }
+
+    bool hit(size_t k, int x) const { return (k != 0) & (b[k] == x); }
+
+public:
+    EytzingerSet() = default;
+    explicit EytzingerSet(const std::vector<int>& sorted) : b(sorted.size() + 1), n(sorted.size()) {
+        b[0] = 0;
+        if (n > 0) fill(sorted.data(), 0, 1);
+        while (((size_t)2 << fullLevels) - 1 <= n) fullLevels++;
+    }
+
+    size_t size() const { return n; }
+    size_t bytes() const { return b.size() * sizeof(int); }
+
+    bool contains(int x) const {
+        size_t k = 1;
+        for (int l = 0; l < fullLevels; l++) {
+            __builtin_prefetch(b.data() + 16 * k);   // the node 4 levels down
+            k = 2 * k + (b[k] < x);
+        }
+        return hit(lowerBoundIndex(lastStep(k, x)), x);
+    }
+
+    void containsBatch(const int* keys, size_t count, bool* out) const {
+        using frozen_detail::GROUP;
+        size_t i = 0;
+        for (; i + GROUP <= count; i += GROUP) {
+            size_t k[GROUP];
+            for (int q = 0; q < GROUP; q++) k[q] = 1;
+            for (int l = 0; l < fullLevels; l++) {
+                for (int q = 0; q < GROUP; q++) {
+                    k[q] = 2 * k[q] + (b[k[q]] < keys[i + q]);
+                    __builtin_prefetch(b.data() + k[q]);
+                }
+            }
+            for (int q = 0; q < GROUP; q++) out[i + q] = hit(lowerBoundIndex(lastStep(k[q], keys[i + q])), keys[i + q]);
+        }
+        for (; i < count; i++) out[i] = contains(keys[i]);
+    }
+};
+
+class VebSet {
+    frozen_detail::AlignedInts a;
+    size_t n = 0;
+    int levels = 0;
+    bool hasIntMax = false;   // INT_MAX is also the padding key
+    // For every depth d > 0, seen as the first level of a bottom subtree in
+    // the recursive cut: size of the top subtree above it, size of each
+    // bottom subtree, and the depth of the top subtree's root
+    // (Brodal, Fagerberg, Jacob 2002). Entry `levels` is all zero, so the
+    // last step may compute a (never used) next position without a branch.
+    struct Cut {
+        int64_t topSize, bottomSize;
+        int topDepth;
+    };
+    std::vector<Cut> cuts;
+
+    void tables(int depth, int h) {
+        if (h <= 1) return;
+        int top = h / 2, bottom = h - top;
+        cuts[depth + top] = {((int64_t)1 << top) - 1, ((int64_t)1 << bottom) - 1, depth};
+        tables(depth, top);
+        tables(depth + top, bottom);
+    }
+
+    // Writes the subtree of height h whose root has BFS index `bfs` (keys in
+    // BFS order in `eyt`, 1-based) at a[pos...]; returns the next free slot.
+    size_t layout(const std::vector<int>& eyt, size_t bfs, int h, size_t pos) {
+        if (h == 1) {
+            a[pos] = eyt[bfs];
+            return pos + 1;
+        }
+        int top = h / 2, bottom = h - top;
+        pos = layout(eyt, bfs, top, pos);
+        for (size_t j = 0; j < ((size_t)1 << top); j++) pos = layout(eyt, (bfs << top) + j, bottom, pos);
+        return pos;
+    }
+
+    size_t fill(const std::vector<int>& sorted, std::vector<int>& eyt, size_t i, size_t k) {
+        if (k >= eyt.size()) return i;
+        i = fill(sorted, eyt, i, 2 * k);
+        eyt[k] = i < sorted.size() ? sorted[i] : INT_MAX;
+        i++;
+        return fill(sorted, eyt, i, 2 * k + 1);
+    }
+
+    // one step of a search: compares at depth d and moves to depth d + 1
+    // (bfs is the node's BFS index, pos[] its slots on the path so far)
+    bool step(int x, int d, size_t& bfs, int64_t* pos) const {
+        int key = a[pos[d]];
+        bfs = 2 * bfs + (key < x);
+        const Cut& c = cuts[d + 1];
+        pos[d + 1] = pos[c.topDepth] + c.topSize + (int64_t)(bfs & c.topSize) * c.bottomSize;
+        return key == x;
+    }
+
+public:
+    VebSet() = default;
+    explicit VebSet(const std::vector<int>& sorted) : n(sorted.size()) {
+        levels = std::max(1, frozen_detail::levelsFor(n));
+        size_t slots = ((size_t)1 << levels) - 1;
+        hasIntMax = n > 0 && sorted.back() == INT_MAX;
+        std::vector<int> eyt(slots + 1);   // padded BFS order first, then rearranged
+        fill(sorted, eyt, 0, 1);
+        a = frozen_detail::AlignedInts(slots);
+        layout(eyt, 1, levels, 0);
+        cuts.assign(levels + 1, Cut{0, 0, 0});
+        tables(0, levels);
+    }
+
+    size_t size() const { return n; }
+    size_t bytes() const { return a.size() * sizeof(int); }
+
+    bool contains(int x) const {
+        int64_t pos[65];
+        pos[0] = 0;
+        size_t bfs = 1;
+        bool found = false;
+        for (int d = 0; d < levels; d++) found |= step(x, d, bfs, pos);
+        return found & (x != INT_MAX || hasIntMax);
+    }
+
+    void containsBatch(const int* keys, size_t count, bool* out) const {
+        using frozen_detail::GROUP;
+        size_t i = 0;
+        for (; i + GROUP <= count; i += GROUP) {
+            int64_t pos[GROUP][65];
+            size_t bfs[GROUP];
+            bool found[GROUP];
+            for (int q = 0; q < GROUP; q++) {
+                pos[q][0] = 0;
+                bfs[q] = 1;
+                found[q] = false;
+            }
+            for (int d = 0; d < levels; d++) {
+                for (int q = 0; q < GROUP; q++) {
+                    found[q] |= step(keys[i + q], d, bfs[q], pos[q]);
+                    __builtin_prefetch(a.data() + pos[q][d + 1]);
+                }
+            }
+            for (int q = 0; q < GROUP; q++) out[i + q] = found[q] & (keys[i + q] != INT_MAX || hasIntMax);
+        }
+        for (; i < count; i++) out[i] = contains(keys[i]);
+    }
+};
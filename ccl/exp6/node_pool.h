@@ -0,0 +1,183 @@
+// Index-based node pool for the exp6 trees. Nodes live in one contiguous
+// mapping and are named by 32-bit indices instead of 64-bit pointers, freed
+// nodes go on an intrusive free list, and every node of a type can be dropped
+// at once without visiting them.
+//
+// PoolRef<T> wraps an index so that tree code written against pointers
+// (node->left, == nullptr, new / delete) works unchanged: make() replaces
+// new, release() replaces delete. HeapRef<T> has the same interface over
+// plain new / delete, so a tree templated on its reference type can be
+// benchmarked both ways. Index 0 is never handed out and plays nullptr.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <sys/mman.h>
+
+template <class T>
+class NodePool {
+    // T may still be incomplete when the class is instantiated (a node holds
+    // refs to its own type), so sizeof(T) is only used inside member bodies.
+    static const uint32_t CHUNK = 1u << 16;    // slots added per growth step, at least
+
+    unsigned char* base = nullptr;  // one page-aligned mapping, node i at base + i * sizeof(T)
+    size_t capacity = 0;        // slots mapped
+    uint32_t used = 1;          // slots ever handed out (slot 0 reserved)
+    uint32_t freeHead = 0;      // 0 = free list empty
+    size_t liveCount = 0;
+
+    static size_t mappedBytes(size_t slots) {
+        size_t page = 4096;
+        return (slots * sizeof(T) + page - 1) / page * page;
+    }
+
+    // Capacity doubles, but only in address space: pages are committed when
+    // first touched, and mremap moves the mapping without copying. Indices
+    // stay valid when the base moves.
+    void grow() {
+        size_t next = capacity == 0 ? CHUNK : capacity * 2;
+        void* p = base == nullptr
+            ? mmap(nullptr, mappedBytes(next), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
+            : mremap(base, mappedBytes(capacity), mappedBytes(next), MREMAP_MAYMOVE);
+        if (p == MAP_FAILED) throw std::bad_alloc();
+        base = static_cast<unsigned char*>(p);
+        capacity = next;
+    }
+
+    void unmap() {
+        if (base != nullptr) munmap(base, mappedBytes(capacity));
+        base = nullptr;
+        capacity = 0;
+        used = 1;
+        freeHead = 0;
+        liveCount = 0;
+    }
+
+public:
+    constexpr NodePool() = default;
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+    ~NodePool() { unmap(); }
+
+    template <class... Args>
+    uint32_t alloc(Args&&... args) {
+        static_assert(sizeof(T) >= sizeof(uint32_t), "free list links are stored in the node");
+        static_assert(4096 % alignof(T) == 0, "slots are only page aligned");
+        uint32_t i;
+        if (freeHead != 0) {
+            i = freeHead;
+            memcpy(&freeHead, slot(i), sizeof freeHead);
+        } else {
+            if (used == UINT32_MAX) throw std::length_error("NodePool: out of indices");
+            if (used >= capacity) {
+                // the arguments may refer into this pool (copying one pooled
+                // tree into another), and grow() can move it: build first
+                T node(std::forward<Args>(args)...);
+                grow();
+                i = used++;
+                new (slot(i)) T(std::move(node));
+                liveCount++;
+                return i;
+            }
+            i = used++;
+        }
+        new (slot(i)) T(std::forward<Args>(args)...);
+        liveCount++;
+        return i;
+    }
+
+    void free(uint32_t i) {
+        (*this)[i].~T();
+        memcpy(slot(i), &freeHead, sizeof freeHead);
+        freeHead = i;
+        liveCount--;
+    }
+
+    void* slot(uint32_t i) const { return base + (size_t)i * sizeof(T); }
+    T& operator[](uint32_t i) const { return *static_cast<T*>(slot(i)); }
+
+    // Frees every node at once; indices handed out before are invalid.
+    void releaseAll() {
+        static_assert(std::is_trivially_destructible<T>::value, "bulk release skips destructors");
+        unmap();
+    }
+
+    size_t live() const { return liveCount; }
+    // memory actually committed (pages touched so far)
+    size_t bytes() const { return mappedBytes(used); }
+};
+
+// Pointer-like 32-bit handle into the NodePool<T> shared by all T nodes.
+template <class T>
+class PoolRef {
+    uint32_t id = 0;
+
+public:
+    static const bool pooled = true;
+    // nodes may be dereferenced from several threads at once, as long as
+    // none of them allocates or frees meanwhile
+    static const bool concurrent = true;
+
+    // constant-initialized, so a dereference needs no init-guard check
+    static inline NodePool<T> shared;
+    static NodePool<T>& pool() { return shared; }
+
+    PoolRef() = default;
+    PoolRef(std::nullptr_t) {}
+
+    template <class... Args>
+    static PoolRef make(Args&&... args) {
+        PoolRef r;
+        r.id = pool().alloc(std::forward<Args>(args)...);
+        return r;
+    }
+    void release() { pool().free(id); }
+    // Frees every T node at once, whichever tree it belongs to: the pool is
+    // shared by all PoolRef<T>, so this is only for when none is still in use.
+    static void releaseAll() { pool().releaseAll(); }
+
+    T* operator->() const { return &pool()[id]; }
+    T& operator*() const { return pool()[id]; }
+    uint32_t index() const { return id; }
+
+    bool operator==(const PoolRef& o) const { return id == o.id; }
+    bool operator!=(const PoolRef& o) const { return id != o.id; }
+    bool operator==(std::nullptr_t) const { return id == 0; }
+    bool operator!=(std::nullptr_t) const { return id != 0; }
+};
+
+// The same interface over new / delete.
+template <class T>
+class HeapRef {
+    T* p = nullptr;
+
+public:
+    static const bool pooled = false;
+    static const bool concurrent = true;
+
+    HeapRef() = default;
+    HeapRef(std::nullptr_t) {}
+
+    template <class... Args>
+    static HeapRef make(Args&&... args) {
+        HeapRef r;
+        r.p = new T(std::forward<Args>(args)...);
+        return r;
+    }
+    void release() { delete p; }
+
+    T* operator->() const { return p; }
+    T& operator*() const { return *p; }
+
+    bool operator==(const HeapRef& o) const { return p == o.p; }
+    bool operator!=(const HeapRef& o) const { return p != o.p; }
+    bool operator==(std::nullptr_t) const { return p == nullptr; }
+    bool operator!=(std::nullptr_t) const { return p != nullptr; }
+};
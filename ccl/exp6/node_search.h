@@ -0,0 +1,125 @@
+// Search inside one sorted B-tree / B+ tree node: the index of the first key
+// >= x among keys[0, n).
+//
+// Large nodes are first narrowed with a branch-free binary search (the
+// compare selects the next window with a conditional move, so there are no
+// mispredictions), down to a window of at most WINDOW keys. That window is
+// then counted with SIMD compares: with int / int64 keys and AVX2 (or SSE2
+// for int), each instruction compares 8 (4) keys against x and a movemask +
+// popcount adds up how many are smaller. Other key types, or builds without
+// the instruction set, finish the branch-free binary search instead.
+//
+// AVX2 is used when the file is compiled with it (-mavx2 or -march=native).
+// The SIMD loads may read up to SIMD_SLACK keys past keys[n - 1], so node
+// key arrays reserve that many extra slots (see keySlots).
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace node_search {
+
+const int SIMD_SLACK = 8;
+const int WINDOW = 32;
+
+// key array length for a node holding up to maxKeys keys
+constexpr int keySlots(int maxKeys) { return maxKeys + SIMD_SLACK; }
+
+template <class Key>
+constexpr bool simdKey() {
+#if defined(__AVX2__)
+    return std::is_same<Key, int32_t>::value || std::is_same<Key, int64_t>::value;
+#elif defined(__SSE2__)
+    return std::is_same<Key, int32_t>::value;
+#else
+    return false;
+#endif
+}
+
+inline const char* simdName() {
+#if defined(__AVX2__)
+    return "AVX2";
+#elif defined(__SSE2__)
+    return "SSE2";
+#else
+    return "none";
+#endif
+}
+
+// keys in [0, len) that are < x, len <= WINDOW
+template <class Key>
+inline int countLess(const Key* keys, int len, Key x) {
+    int count = 0;
+#if defined(__AVX2__)
+    if constexpr (std::is_same<Key, int32_t>::value) {
+        __m256i vx = _mm256_set1_epi32(x);
+        for (int i = 0; i < len; i += 8) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(keys + i));
+            unsigned mask = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(vx, v)));
+            int valid = len - i < 8 ? len - i : 8;
+            count += __builtin_popcount(mask & ((1u << valid) - 1));
+        }
+        return count;
+    } else if constexpr (std::is_same<Key, int64_t>::value) {
+        __m256i vx = _mm256_set1_epi64x(x);
+        for (int i = 0; i < len; i += 4) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(keys + i));
+            unsigned mask = (unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(vx, v)));
+            int valid = len - i < 4 ? len - i : 4;
+            count += __builtin_popcount(mask & ((1u << valid) - 1));
+        }
+        return count;
+    }
+#elif defined(__SSE2__)
+    if constexpr (std::is_same<Key, int32_t>::value) {
+        __m128i vx = _mm_set1_epi32(x);
+        for (int i = 0; i < len; i += 4) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(keys + i));
+            unsigned mask = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(vx, v)));
+            int valid = len - i < 4 ? len - i : 4;
+            count += __builtin_popcount(mask & ((1u << valid) - 1));
+        }
+        return count;
+    }
+#endif
+    for (int i = 0; i < len; i++) count += keys[i] < x;
+    return count;
+}
+
+// first index in [0, n) with keys[index] >= x, n if none
+template <class Key>
+inline int lowerBound(const Key* keys, int n, const Key& x) {
+    const Key* base = keys;
+    int len = n;
+    const int stop = simdKey<Key>() ? WINDOW : 0;
+    // the answer stays in [base, base + len]
+    while (len > stop) {
+        int half = len / 2;
+        bool right = base[half] < x;
+        base = right ? base + half + 1 : base;
+        len = right ? len - half - 1 : half;
+    }
+    int index = (int)(base - keys);
+    if constexpr (simdKey<Key>()) index += countLess(base, len, x);
+    return index;
+}
+
+// first index in [0, n) with keys[index] > x, n if none
+template <class Key>
+inline int upperBound(const Key* keys, int n, const Key& x) {
+    const Key* base = keys;
+    int len = n;
+    while (len > 0) {
+        int half = len / 2;
+        bool right = !(x < base[half]);
+        base = right ? base + half + 1 : base;
+        len = right ? len - half - 1 : half;
+    }
+    return (int)(base - keys);
+}
+
+}  // namespace node_search